@@ -1,3 +1,4 @@
+#define CUSTOM_PROCESSKEYHELD // U and D keep dimming while held
 #include "aircraft.h"
 #include <EEPROM.h>
 
@@ -56,10 +57,10 @@ void allLightsOff() {
   light6.off();
 }
 
-void updateAll() {
-  light1.update();
-  light5.update();
-  light6.update();
+void updateAll(const uint32_t now) {
+  updateIfDue(light1, now);
+  updateIfDue(light5, now);
+  updateIfDue(light6, now);
 }
 
 void allOff() {
@@ -88,17 +89,11 @@ void processKey(const uint32_t key) {
   Serial.println(key, HEX);
   switch (key) {
   case '0':
-  case RC65X_KEY0:
-  case RC65X_KEYDOWN: // Control wheel down
-  case RM_YD065_KEY0:
-  case RM_YD065_KEYDOWN:
     Serial.print(F("Got remote \"0\"\n"));
     setToMode(MODE_OVERRIDE);
     allOff();
     break;
   case '1':
-  case RC65X_KEY1:
-  case RM_YD065_KEY1:
     Serial.print(F("Got remote \"1\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.1);
@@ -107,8 +102,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case '2':
-  case RC65X_KEY2:
-  case RM_YD065_KEY2:
     Serial.print(F("Got remote \"2\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.2);
@@ -117,8 +110,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case '3':
-  case RC65X_KEY3:
-  case RM_YD065_KEY3:
     Serial.print(F("Got remote \"3\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.3);
@@ -127,8 +118,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case '4':
-  case RC65X_KEY4:
-  case RM_YD065_KEY4:
     Serial.print(F("Got remote \"4\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.4);
@@ -137,8 +126,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case '5':
-  case RC65X_KEY5:
-  case RM_YD065_KEY5:
     Serial.print(F("Got remote \"5\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.5);
@@ -147,8 +134,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case '6':
-  case RC65X_KEY6:
-  case RM_YD065_KEY6:
     Serial.print(F("Got remote \"6\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.6);
@@ -157,8 +142,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case '7':
-  case RC65X_KEY7:
-  case RM_YD065_KEY7:
     Serial.print(F("Got remote \"7\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.7);
@@ -167,15 +150,11 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case 'B':
-  case RC65X_KEYRED:
-  case RM_YD065_KEYRED:
     Serial.print(F("Got remote \"B\"\n"));
     setToMode(MODE_BATTERYLOW);
     allLightsOn();
     break;
   case '8':
-  case RC65X_KEY8:
-  case RM_YD065_KEY8:
     Serial.print(F("Got remote \"8\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.8);
@@ -184,8 +163,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case '9':
-  case RC65X_KEY9:
-  case RM_YD065_KEY9:
     Serial.print(F("Got remote \"9\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.setOnLightLevel(ON*.9);
@@ -194,9 +171,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case 'U':
-  case RC65X_KEYCHANUP:
-  case RM_YD065_KEYVOLUMEUP:
-  case RM_YD065_KEYPROGUP:
     Serial.print(F("Got remote \"U\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.incrementOnLightLevel(5);
@@ -205,9 +179,6 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case 'D':
-  case RC65X_KEYCHANDOWN:
-  case RM_YD065_KEYVOLUMEDOWN:
-  case RM_YD065_KEYPROGDOWN:
     Serial.print(F("Got remote \"D\"\n"));
     setToMode(MODE_OVERRIDE);
     light1.incrementOnLightLevel(-5);
@@ -216,12 +187,7 @@ void processKey(const uint32_t key) {
     allLightsOn();
     break;
   case 'P':
-  case RC65X_KEYPLAY:
-  case RC65X_KEYSELECT:
-  case RM_YD065_KEYPLAY:
-  case RM_YD065_KEYOK:
-  case RC65X_KEYUP: // Control wheel up
-  case RM_YD065_KEYUP:
+  case '^': // Control wheel up
     Serial.print(F("Got remote \"P\"\n"));
     const uint16_t lightLevel = hw.photocell2();
     const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel);
@@ -234,6 +200,16 @@ void processKey(const uint32_t key) {
   }
 }
 
+void processKeyHeld(const uint32_t key) {
+  // Keep dimming while U or D is held
+  switch (key) {
+  case 'U':
+  case 'D':
+    processKey(key);
+    break;
+  }
+}
+
 void serialPrintCustomStatus()
 {
   sprintf(sprintfBuffer,
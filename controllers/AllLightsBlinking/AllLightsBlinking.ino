@@ -68,15 +68,15 @@ void allLightsOff() {
   light7.off();
 }
 
-void updateAll() {
+void updateAll(const uint32_t now) {
   //  Serial.println(F("In updateAll()"));
-  light1.update();
-  light2.update();
-  light3.update(); // If comment this out, works without a delay
-  light4.update();
-  light5.update();
-  light6.update();
-  light7.update();
+  updateIfDue(light1, now);
+  updateIfDue(light2, now);
+  updateIfDue(light3, now); // If comment this out, works without a delay
+  updateIfDue(light4, now);
+  updateIfDue(light5, now);
+  updateIfDue(light6, now);
+  updateIfDue(light7, now);
   delay(10);       // If comment out this and not 3, will not work 
 }
 
@@ -127,50 +127,31 @@ void processKey(const uint32_t key) {
   Serial.println(key, HEX);
   switch (key) {
   case '0':
-  case RC65X_KEY0:
-  case RC65X_KEYDOWN: // Control wheel down
-  case RM_YD065_KEY0:
-  case RM_YD065_KEYDOWN:
     Serial.print(F("Got remote \"0\"\n"));
     setToMode(MODE_OVERRIDE);
     allOff();
     break;
   case 'B':
-  case RC65X_KEYRED:
-  case RM_YD065_KEYRED:
     Serial.print(F("Got remote \"B\"\n"));
     setToMode(MODE_BATTERYLOW);
     break;
   case '8':
-  case RC65X_KEY8:
-  case RC65X_KEYUP: // Control wheel up
-  case RM_YD065_KEY8:
-  case RM_YD065_KEYUP:
+  case '^': // Control wheel up
     Serial.print(F("Got remote \"8\"\n"));
     setToMode(MODE_OVERRIDE);
     allLightsOn();
     break;
   case 'U':
-  case RC65X_KEYCHANUP:
-  case RM_YD065_KEYVOLUMEUP:
-  case RM_YD065_KEYPROGUP:
     Serial.print(F("Got remote \"U\"\n"));
     setToMode(MODE_OVERRIDE);
     allLightsOn();
     break;
   case 'D':
-  case RC65X_KEYCHANDOWN:
-  case RM_YD065_KEYVOLUMEDOWN:
-  case RM_YD065_KEYPROGDOWN:
     Serial.print(F("Got remote \"D\"\n"));
     setToMode(MODE_OVERRIDE);
     allLightsOff();
     break;
   case 'P':
-  case RC65X_KEYPLAY:
-  case RC65X_KEYSELECT:
-  case RM_YD065_KEYPLAY:
-  case RM_YD065_KEYOK:
     Serial.print(F("Got remote \"P\"\n"));
     const uint16_t lightLevel = hw.photocell2();
     const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel);
@@ -187,11 +168,11 @@ void serialPrintCustomStatus()
 
 void setupLightingAndMotorChannels()
 {
-  light1.setup(hw.o1, ON, ON);
-  light2.setup(hw.o2, ON, ON);
-  light3.setup(hw.o3, ON, ON);
-  light4.setup(hw.o4, ON, ON);
-  light5.setup(hw.o5, ON, ON);
-  light6.setup(hw.o6, ON, ON);
-  light7.setup(hw.o7, ON, ON);
+  light1.setup(hw.o1, ON);
+  light2.setup(hw.o2, ON);
+  light3.setup(hw.o3, ON);
+  light4.setup(hw.o4, ON);
+  light5.setup(hw.o5, ON);
+  light6.setup(hw.o6, ON);
+  light7.setup(hw.o7, ON);
 }
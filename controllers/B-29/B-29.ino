@@ -46,16 +46,18 @@ UpDownMotor upDownMotor = UpDownMotor();
 
 // Decay settings for position lights
 // Note: Added .01 sec to on & decay lengths so will not be in sync with F-16
-uint32_t positionOnLengths[1]          =    {110}; // On for .11 seconds
-uint32_t positionDecayLengths[1]       =   {1110}; // Decay for 1.11
-uint8_t  positionMaxLightLevels[1]     =     {ON}; // Full on when on  
-uint32_t positionTauInMilliseconds[1]  =    {175}; // Half-life = .05 seconds
+const DecayLight::Interval positionIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(110),     // On for .11 seconds
+  LUCKY7_DURATION(1110),    // Decay for 1.11
+  LUCKY7_DURATION(175),     // Half-life = .05 seconds
+  ON}};                     // Full on when on
 
 // Decay settings for taxi lights during day and night
-uint32_t   landingDayOnLengths[1]      = {300000}; // On 5 minutes
-uint32_t   landingDayDecayLengths[1]   = { 60000}; // Off for 1 minute (changed 7/18/2016, was 5 min)
-uint8_t    landingDayMaxLightLevels[1] =     {ON}; // Full on when on  
-uint32_t * landingDayTauInMilliseconds =     NULL; // On/Off, no decay
+const DecayLight::Interval landingDayIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(300000),    // On 5 minutes
+  LUCKY7_DURATION(60000),     // Off for 1 minute (changed 7/18/2016, was 5 min)
+  0,                          // On/Off, no decay
+  ON}};                       // Full on when on
 
 // Light objects to control each channel
 Light      ident    ; // Identification: Mid-Fuselete Bottom Identification (3)
@@ -101,13 +103,13 @@ void allLightsOff() {
   formation.off();
 }
 
-void updateAll() {
-  ident.update();
-  landing.update();
-  illum.update();
-  position.update();
-  formation.update();
-  upDownMotor.motorUpdate();
+void updateAll(const uint32_t now) {
+  updateIfDue(ident, now);
+  updateIfDue(landing, now);
+  updateIfDue(illum, now);
+  updateIfDue(position, now);
+  updateIfDue(formation, now);
+  upDownMotor.motorUpdate(now);
 }
 
 void allOff() {
@@ -160,93 +162,60 @@ void processKey(const uint32_t key) {
   Serial.println(key, HEX);
   switch (key) {
   case '0':
-  case RC65X_KEY0:
-  case RC65X_KEYDOWN: // Control wheel down
-  case RM_YD065_KEY0:
-  case RM_YD065_KEYDOWN:
     Serial.print(F("Got remote \"0\"\n"));
     setToMode(MODE_OVERRIDE);
     allOff();
     break;
   case '1':
-  case RC65X_KEY1:
-  case RM_YD065_KEY1:
     Serial.print(F("Got remote \"1\"\n"));
     setToMode(MODE_OVERRIDE);
     ident.toggle();
     break;
   case '2':
-  case RC65X_KEY2:
-  case RM_YD065_KEY2:
     Serial.print(F("Got remote \"2\"\n"));
     setToMode(MODE_OVERRIDE);
     landing.toggle();
     break;
 //    case '3':
-//    case RC65X_KEY3:
-//    case RM_YD065_KEY3:
-//        hw.o3Toggle();
+//        hw.outputToggle(2); // o3
 //        break;
   case '4':
-  case RC65X_KEY4:
-  case RM_YD065_KEY4:
     Serial.print(F("Got remote \"4\"\n"));
     setToMode(MODE_OVERRIDE);
     illum.toggle();
     break;
   case '5':
-  case RC65X_KEY5:
-  case RM_YD065_KEY5:
     Serial.print(F("Got remote \"5\"\n"));
     setToMode(MODE_OVERRIDE);
     position.toggle();
     break;
   case '6':
-  case RC65X_KEY6:
-  case RM_YD065_KEY6:
     Serial.print(F("Got remote \"6\"\n"));
     setToMode(MODE_OVERRIDE);
     formation.toggle();
     break;
 //    case '7':
-//    case RC65X_KEY7:
-//    case RM_YD065_KEY7:
-//        hw.o7Toggle();
+//        hw.outputToggle(6); // o7
 //        break;
   case 'B':
-  case RC65X_KEYRED:
-  case RM_YD065_KEYRED:
     Serial.print(F("Got remote \"B\"\n"));
     setToMode(MODE_BATTERYLOW);
     break;
   case '8':
-  case RC65X_KEY8:
-  case RC65X_KEYUP: // Control wheel up
-  case RM_YD065_KEY8:
-  case RM_YD065_KEYUP:
+  case '^': // Control wheel up
     Serial.print(F("Got remote \"8\"\n"));
     setToMode(MODE_OVERRIDE);
     allLightsOn();
     break;
   case 'U':
-  case RC65X_KEYCHANUP:
-  case RM_YD065_KEYVOLUMEUP:
-  case RM_YD065_KEYPROGUP:
     Serial.print(F("Got remote \"U\"\n"));
-    upDownMotor.motorUpStart();
+    upDownMotor.motorUpStart(hw.frame.now);
     break;
   case 'D':
-  case RC65X_KEYCHANDOWN:
-  case RM_YD065_KEYVOLUMEDOWN:
-  case RM_YD065_KEYPROGDOWN:
     Serial.print(F("Got remote \"D\"\n"));
-    upDownMotor.motorDownStart();
+    upDownMotor.motorDownStart(hw.frame.now);
     break;
   case 'P':
-  case RC65X_KEYPLAY:
-  case RC65X_KEYSELECT:
-  case RM_YD065_KEYPLAY:
-  case RM_YD065_KEYOK:
     Serial.print(F("Got remote \"P\"\n"));
     const uint16_t lightLevel = hw.photocell2();
     const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel);
@@ -266,13 +235,13 @@ void serialPrintCustomStatus()
 void setupLightingAndMotorChannels()
 {
   ident     .setup(hw.o1, ON);
-  landing   .setup(hw.o2, ON, 1, landingDayOnLengths, landingDayDecayLengths,
-                   landingDayMaxLightLevels, landingDayTauInMilliseconds);
+  landing   .setup(hw.o2, ON, 1, landingDayIntervals);
   illum     .setup(hw.o4, ON);
-  position  .setup(hw.o5, ON, 1, positionOnLengths, positionDecayLengths,
-                   positionMaxLightLevels, positionTauInMilliseconds);
+  position  .setup(hw.o5, ON, 1, positionIntervals);
   formation .setup(hw.o6, ON);
 
   upDownMotor.setup(hw.o3, hw.o7); // Initialize with (up, down) outputs
+  hw.setCrossfade(3, false);        // Motors switch, they don't fade
+  hw.setCrossfade(7, false);
 }
 
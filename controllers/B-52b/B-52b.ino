@@ -34,19 +34,31 @@ Light      tailFloods;    // Two flood lighs on horizontal that illuminate the t
 const uint8_t  catwalkMaxLightLevelDay     = uint8_t(.8*ON); // 80% Max
 //const uint8_t  catwalkMaxLightLevelNight = uint8_t(.6*ON); // 60% Max
 const uint8_t  catwalkMaxLightLevelNight   = uint8_t(.5*ON);
-uint32_t       catwalkDayOnLengths[1]      = {180000};       // On 3 minutes
 //uint32_t catwalkDayDecayLengths[1]       = { 61000};       // Off for 1 minute, plus 1 sec to keep out of sync
-uint32_t       catwalkDayDecayLengths[1]   = { 91000};       // Off for 90 seconds, plus 1 sec to keep out of sync
-uint8_t        catwalkDayMaxLightLevels[1] = {catwalkMaxLightLevelDay};  
-uint32_t     * catwalkDayTauInMilliseconds = NULL;           // On/Off, no decay
+const DecayLight::Interval catwalkDayIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(180000),    // On 3 minutes
+  LUCKY7_DURATION(91000),     // Off for 90 seconds, plus 1 sec to keep out of sync
+  0,                          // On/Off, no decay
+  catwalkMaxLightLevelDay}};
+const DecayLight::Interval catwalkNightIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(180000),    // On 3 minutes
+  LUCKY7_DURATION(91000),     // Off for 90 seconds, plus 1 sec to keep out of sync
+  0,                          // On/Off, no decay
+  catwalkMaxLightLevelNight}};
 
 // Flashing settings for loader's lights
 const uint8_t  loaderMaxLightLevelDay      = uint8_t(.8*ON);  // 80% Max
 const uint8_t  loaderMaxLightLevelNight    = uint8_t(.6*ON);  // 60% Max
-uint32_t       loaderDayOnLengths[1]       = {180000};        // On 3 minutes
-uint32_t       loaderDayDecayLengths[1]    = { 61500};        // Off for 1 minute, 15 seconds to keep out of sync
-uint8_t        loaderDayMaxLightLevels[1]  = {loaderMaxLightLevelDay};  
-uint32_t     * loaderDayTauInMilliseconds  = NULL;            // On/Off, no decay
+const DecayLight::Interval loaderDayIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(180000),    // On 3 minutes
+  LUCKY7_DURATION(61500),     // Off for 1 minute, 15 seconds to keep out of sync
+  0,                          // On/Off, no decay
+  loaderMaxLightLevelDay}};
+const DecayLight::Interval loaderNightIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(180000),    // On 3 minutes
+  LUCKY7_DURATION(61500),     // Off for 1 minute, 15 seconds to keep out of sync
+  0,                          // On/Off, no decay
+  loaderMaxLightLevelNight}};
 
 // Settings for tail floods
 const uint8_t  tailFloodsMaxLightLevel     = uint8_t(0.8*ON); // 80% Max
@@ -90,13 +102,13 @@ void allLightsOff() {
   tailFloods    .off();
 }
 
-void updateAll() {
-  catwalk       .update();
-  interiorWhite .update();
-  interiorRed   .update();
-  cockpitFloods .update();
-  loader        .update();
-  tailFloods    .update();
+void updateAll(const uint32_t now) {
+  updateIfDue(catwalk,        now);
+  updateIfDue(interiorWhite,  now);
+  updateIfDue(interiorRed,    now);
+  updateIfDue(cockpitFloods,  now);
+  updateIfDue(loader,         now);
+  updateIfDue(tailFloods,     now);
 }
 
 void allOff() {
@@ -105,14 +117,14 @@ void allOff() {
 
 // -------------------- Time of Day Settings ----------------
 void setEvening() {
-  catwalkDayMaxLightLevels[0] = catwalkMaxLightLevelNight;  
+  catwalk       .setIntervals(catwalkNightIntervals);
   //  catwalk       .flash(); 2/18/17
   catwalk       .off();
   interiorWhite .off();
   // interiorRed   .on();
   interiorRed   .off();
   cockpitFloods .off();
-  loaderDayMaxLightLevels[0] = loaderMaxLightLevelNight;
+  loader        .setIntervals(loaderNightIntervals);
   // loader        .flash(); 2/18/17
   loader        .off();
   //tailFloods    .on(); 2/18/17
@@ -144,12 +156,12 @@ void setMorning() {
 }
 
 void setDay() {
-  catwalkDayMaxLightLevels[0] = catwalkMaxLightLevelDay;  
+  catwalk       .setIntervals(catwalkDayIntervals);
   catwalk       .flash();
   interiorWhite .off();
   interiorRed   .off();
   cockpitFloods .off();
-  loaderDayMaxLightLevels[0] = loaderMaxLightLevelDay;
+  loader        .setIntervals(loaderDayIntervals);
   loader        .flash();
   tailFloods    .off();
 }
@@ -159,83 +171,56 @@ void processKey(const uint32_t key) {
   Serial.println(key, HEX);
   switch (key) {
   case '0':
-  case RC65X_KEY0:
-  case RC65X_KEYDOWN: // Control wheel down
-  case RM_YD065_KEY0:
-  case RM_YD065_KEYDOWN:
     Serial.print(F("Got remote \"0\"\n"));
     setToMode(MODE_OVERRIDE);
     allOff();
     break;
   case '1':
-  case RC65X_KEY1:
-  case RM_YD065_KEY1:
     Serial.print(F("Got remote \"1\"\n"));
     setToMode(MODE_OVERRIDE);
     catwalk.toggle();
     break;
   case '2':
-  case RC65X_KEY2:
-  case RM_YD065_KEY2:
     Serial.print(F("Got remote \"2\"\n"));
     setToMode(MODE_OVERRIDE);
     interiorWhite.toggle();
     break;
   case '3':
-  case RC65X_KEY3:
-  case RM_YD065_KEY3:
     Serial.print(F("Got remote \"3\"\n"));
     setToMode(MODE_OVERRIDE);
     interiorRed.toggle();
     break;
   case '4':
-  case RC65X_KEY4:
-  case RM_YD065_KEY4:
     Serial.print(F("Got remote \"4\"\n"));
     setToMode(MODE_OVERRIDE);
     cockpitFloods.toggle();
     break;
   case '5':
-  case RC65X_KEY5:
-  case RM_YD065_KEY5:
     Serial.print(F("Got remote \"5\"\n"));
     setToMode(MODE_OVERRIDE);
     loader.toggle();
     break;
   case '6':
-  case RC65X_KEY6:
-  case RM_YD065_KEY6:
     Serial.print(F("Got remote \"6\"\n"));
     setToMode(MODE_OVERRIDE);
     tailFloods.toggle();
     break;
 //   case '7':
-//   case RC65X_KEY7:
-//   case RM_YD065_KEY7:
 //     Serial.print(F("Got remote \"7\"\n"));
 //     setToMode(MODE_OVERRIDE);
 //     floods.toggle();
 //     break;
   case 'B':
-  case RC65X_KEYRED:
-  case RM_YD065_KEYRED:
     Serial.print(F("Got remote \"B\"\n"));
     setToMode(MODE_BATTERYLOW);
     break;
   case '8':
-  case RC65X_KEY8:
-  case RC65X_KEYUP: // Control wheel up
-  case RM_YD065_KEY8:
-  case RM_YD065_KEYUP:
+  case '^': // Control wheel up
     Serial.print(F("Got remote \"8\"\n"));
     setToMode(MODE_OVERRIDE);
     allLightsOn();
     break;
   case 'P':
-  case RC65X_KEYPLAY:
-  case RC65X_KEYSELECT:
-  case RM_YD065_KEYPLAY:
-  case RM_YD065_KEYOK:
     Serial.print(F("Got remote \"P\"\n"));
     const uint16_t lightLevel = hw.photocell2();
     const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel);
@@ -254,14 +239,10 @@ void serialPrintCustomStatus()
 
 void setupLightingAndMotorChannels()
 {
-  catwalk      .setup(hw.o1, catwalkMaxLightLevelDay, 
-                      1, catwalkDayOnLengths, catwalkDayDecayLengths,
-                      catwalkDayMaxLightLevels, catwalkDayTauInMilliseconds);
+  catwalk      .setup(hw.o1, catwalkMaxLightLevelDay, 1, catwalkDayIntervals);
   interiorWhite.setup(hw.o2, ON);
   interiorRed  .setup(hw.o3, ON);
   cockpitFloods.setup(hw.o4, ON);
-  loader       .setup(hw.o5, loaderMaxLightLevelDay, 
-                      1, loaderDayOnLengths, loaderDayDecayLengths,
-                      loaderDayMaxLightLevels, loaderDayTauInMilliseconds);
+  loader       .setup(hw.o5, loaderMaxLightLevelDay, 1, loaderDayIntervals);
   tailFloods   .setup(hw.o6, tailFloodsMaxLightLevel);
 }
@@ -34,22 +34,30 @@ RotatingLight   collision;      // Anti-Collision lights on lft & rht top before
 // Flashing settings for taxi lights during day and night
 const uint8_t  taxiMaxLightLevelDay        = uint8_t(.8*ON); // 80% Max
 const uint8_t  taxiMaxLightLevelNight      = uint8_t(.6*ON); // 60% Max
-uint32_t       taxiOnLengths[1]            = {180000}; // On 3 minutes
-uint32_t       taxiDecayLengths[1]         = { 60000}; // Off for 1 minute
-uint8_t        taxiMaxLightLevels[1]       = {taxiMaxLightLevelDay};  
-uint32_t     * taxiTauInMilliseconds       = NULL;     // On/Off, no decay
+const DecayLight::Interval taxiDayIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(180000),    // On 3 minutes
+  LUCKY7_DURATION(60000),     // Off for 1 minute
+  0,                          // On/Off, no decay
+  taxiMaxLightLevelDay}};
+const DecayLight::Interval taxiNightIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(180000),    // On 3 minutes
+  LUCKY7_DURATION(60000),     // Off for 1 minute
+  0,                          // On/Off, no decay
+  taxiMaxLightLevelNight}};
 
 // Decay settings for catwalk lights during day and night
-uint32_t       catwalkDayOnLengths[1]      = {180000}; // On 3 minutes
-uint32_t       catwalkDayDecayLengths[1]   = { 91000}; // Off for 90 seconds, plus 1 sec to keep out of sync
-uint8_t        catwalkDayMaxLightLevels[1] = {ON};  
-uint32_t     * catwalkDayTauInMilliseconds = NULL;     // On/Off, no decay
+const DecayLight::Interval catwalkDayIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(180000),    // On 3 minutes
+  LUCKY7_DURATION(91000),     // Off for 90 seconds, plus 1 sec to keep out of sync
+  0,                          // On/Off, no decay
+  ON}};
 
 // Flashing settings for navigation lights
-uint32_t navigationOnLengths[1]            = { 100};   // On for .1 seconds
-uint32_t navigationDecayLengths[1]         = {1100};   // Decay for 1.1
-uint8_t  navigationMaxLightLevels[1]       = {ON};  
-uint32_t navigationTauInMilliseconds[1]    = { 100};   // Half-life = .1 seconds
+const DecayLight::Interval navigationIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(100),     // On for .1 seconds
+  LUCKY7_DURATION(1100),    // Decay for 1.1
+  LUCKY7_DURATION(100),     // Half-life = .1 seconds
+  ON}};
 
 // Flashing settings for collision lights
 const uint8_t  collisionOnLightLevel       = ON;  // When light is not "rotating", just on, this is its intensity
@@ -97,12 +105,12 @@ void allLightsOff() {
   collision   .off();
 }
 
-void updateAll() {
-  taxi        .update();
-  landing     .update();
-  catwalk     .update();
-  navigation  .update();
-  collision   .update();
+void updateAll(const uint32_t now) {
+  updateIfDue(taxi,         now);
+  updateIfDue(landing,      now);
+  updateIfDue(catwalk,      now);
+  updateIfDue(navigation,   now);
+  updateIfDue(collision,    now);
 }
 
 void allOff() {
@@ -111,7 +119,7 @@ void allOff() {
 
 // -------------------- Time of Day Settings ----------------
 void setEvening() {
-  taxiMaxLightLevels[0] = taxiMaxLightLevelNight;  
+  taxi        .setIntervals(taxiNightIntervals);
   taxi        .off();
   landing     .off();
   catwalk     .off();
@@ -124,7 +132,7 @@ void setNight() {
 }
 
 void setPreDawn() {
-  taxiMaxLightLevels[0] = taxiMaxLightLevelNight;  
+  taxi        .setIntervals(taxiNightIntervals);
   taxi        .off();
   landing     .off();
   catwalk     .off();
@@ -133,7 +141,7 @@ void setPreDawn() {
 }
 
 void setMorning() {
-  taxiMaxLightLevels[0] = taxiMaxLightLevelDay;  
+  taxi        .setIntervals(taxiDayIntervals);
   taxi        .off();
   landing     .on();
   catwalk     .off();
@@ -142,7 +150,7 @@ void setMorning() {
 }
 
 void setDay() {
-  taxiMaxLightLevels[0] = taxiMaxLightLevelDay;  
+  taxi        .setIntervals(taxiDayIntervals);
   taxi        .off();
   landing     .on();
   catwalk     .flash();
@@ -162,83 +170,56 @@ void processKey(const uint32_t key) {
     status();
     break;
   case '0':
-  case RC65X_KEY0:
-  case RC65X_KEYDOWN: // Control wheel down
-  case RM_YD065_KEY0:
-  case RM_YD065_KEYDOWN:
     Serial.print(F("Got remote \"0\"\n"));
     setToMode(MODE_OVERRIDE);
     allOff();
     break;
   case '1':
-  case RC65X_KEY1:
-  case RM_YD065_KEY1:
     Serial.print(F("Got remote \"1\"\n"));
     setToMode(MODE_OVERRIDE);
     taxi.toggle();
     break;
   case '2':
-  case RC65X_KEY2:
-  case RM_YD065_KEY2:
     Serial.print(F("Got remote \"2\"\n"));
     setToMode(MODE_OVERRIDE);
     landing.toggle();
     break;
   case '3':
-  case RC65X_KEY3:
-  case RM_YD065_KEY3:
     Serial.print(F("Got remote \"3\"\n"));
     setToMode(MODE_OVERRIDE);
     catwalk.toggle();
     break;
   // case '4':
-  // case RC65X_KEY4:
-  // case RM_YD065_KEY4:
   //   Serial.print(F("Got remote \"4\"\n"));
   //   setToMode(MODE_OVERRIDE);
   //   something.toggle();
   //   break;
   case '5':
-  case RC65X_KEY5:
-  case RM_YD065_KEY5:
     Serial.print(F("Got remote \"5\"\n"));
     setToMode(MODE_OVERRIDE);
     navigation.toggle();
     break;
   case '6':
-  case RC65X_KEY6:
-  case RM_YD065_KEY6:
     Serial.print(F("Got remote \"6\"\n"));
     setToMode(MODE_OVERRIDE);
     collision.toggle();
     break;
 //   case '7':
-//   case RC65X_KEY7:
-//   case RM_YD065_KEY7:
 //     Serial.print(F("Got remote \"7\"\n"));
 //     setToMode(MODE_OVERRIDE);
 //     floods.toggle();
 //     break;
   case 'B':
-  case RC65X_KEYRED:
-  case RM_YD065_KEYRED:
     Serial.print(F("Got remote \"B\"\n"));
     setToMode(MODE_BATTERYLOW);
     break;
   case '8':
-  case RC65X_KEY8:
-  case RC65X_KEYUP: // Control wheel up
-  case RM_YD065_KEY8:
-  case RM_YD065_KEYUP:
+  case '^': // Control wheel up
     Serial.print(F("Got remote \"8\"\n"));
     setToMode(MODE_OVERRIDE);
     allLightsOn();
     break;
   case 'P':
-  case RC65X_KEYPLAY:
-  case RC65X_KEYSELECT:
-  case RM_YD065_KEYPLAY:
-  case RM_YD065_KEYOK:
     Serial.print(F("Got remote \"P\"\n"));
     const uint16_t lightLevel = hw.photocell2();
     const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel);
@@ -257,13 +238,10 @@ void serialPrintCustomStatus()
 
 void setupLightingAndMotorChannels()
 {
-  taxi       .setup(hw.o1, ON, 1, taxiOnLengths, taxiDecayLengths,
-                    taxiMaxLightLevels, taxiTauInMilliseconds);
+  taxi       .setup(hw.o1, ON, 1, taxiDayIntervals);
   landing    .setup(hw.o2, ON);
-  catwalk    .setup(hw.o3, ON, 1, catwalkDayOnLengths, catwalkDayDecayLengths,
-                    catwalkDayMaxLightLevels, catwalkDayTauInMilliseconds);
-  navigation .setup(hw.o5, ON, 1, navigationOnLengths, navigationDecayLengths,
-                    navigationMaxLightLevels, navigationTauInMilliseconds);
+  catwalk    .setup(hw.o3, ON, 1, catwalkDayIntervals);
+  navigation .setup(hw.o5, ON, 1, navigationIntervals);
   collision  .setup(hw.o6, collisionOnLightLevel, collisionFlatLength,          
                     collisionFlatLightLevel, collisionPulseLength,
                     collisionMinLightLevel, collisionMaxLightLevel);
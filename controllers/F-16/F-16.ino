@@ -28,28 +28,31 @@
 //     Tail Illumination (2)
 
 // Decay settings for position lights
-uint32_t positionOnLengths[1]          = {100};  // On for .1 seconds
-uint32_t positionDecayLengths[1]       = {1100}; // Decay for 1.1
-uint8_t  positionMaxLightLevels[1]     = {ON};  
-uint32_t positionTauInMilliseconds[1]  = {100};  // Half-life = .1 seconds
+const DecayLight::Interval positionIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(100),     // On for .1 seconds
+  LUCKY7_DURATION(1100),    // Decay for 1.1
+  LUCKY7_DURATION(100),     // Half-life = .1 seconds
+  ON}};
 
 // Decay settings for collision lights
-uint32_t collisionOnLengths[2]         = {50,50};   // On : .05s, .05s
-uint32_t collisionDecayLengths[2]      = {250,1500};// Off: .25s, then 1.75 s
-uint8_t  collisionMaxLightLevels[2]    = {ON,ON};      // Full power
-uint32_t * collisionTauInMilliseconds  = NULL;     // On/Off, no decay
+// On : .05s, .05s; Off: .25s, then 1.75 s; Full power; On/Off, no decay
+const DecayLight::Interval collisionIntervals[2] PROGMEM = {
+  {LUCKY7_DURATION(50), LUCKY7_DURATION( 250), 0, ON},
+  {LUCKY7_DURATION(50), LUCKY7_DURATION(1500), 0, ON}};
 
 // Decay settings for taxi lights during day and night
-uint32_t taxiDayOnLengths[1]           = {300000}; // On 5 minutes
-uint32_t taxiDayDecayLengths[1]        = { 60000}; // Off for 1 minute (changed 7/18/2016, was 5 min)
-uint8_t  taxiDayMaxLightLevels[1]      = {ON};  
-uint32_t * taxiDayTauInMilliseconds    = NULL;     // On/Off, no decay
-
-// Light objects to control each channel
-DecayLight taxi     ; // Taxi          : Landing lighs on rear wheels (2)
-DecayLight position ; // Position      : Wing tips (2), Intake sides (2)
-DecayLight collision; // Collision     : Top of tail (2)
-Light      floods   ; // Floods        : Tail Illumination (2)
+const DecayLight::Interval taxiDayIntervals[1] PROGMEM = {{
+  LUCKY7_DURATION(300000),    // On 5 minutes
+  LUCKY7_DURATION(60000),     // Off for 1 minute (changed 7/18/2016, was 5 min)
+  0,                          // On/Off, no decay
+  ON}};
+
+// All four lights are channels of one LightBank, updated together
+LightBank<4> lights;
+uint8_t taxi     ; // Taxi          : Landing lighs on rear wheels (2)
+uint8_t position ; // Position      : Wing tips (2), Intake sides (2)
+uint8_t collision; // Collision     : Top of tail (2)
+uint8_t floods   ; // Floods        : Tail Illumination (2)
 
 void serialPrintBanner() {
     Serial.println(F("NMNSH F-16 Lighting Controller v1.0"));
@@ -73,24 +76,15 @@ bool overrideBatteryLow() {
 }
 
 void allLightsOn() {
-  taxi     .on();
-  position .on();
-  collision.on();
-  floods   .on();
+  lights.allOn();
 }
 
 void allLightsOff() {
-  taxi     .off();
-  position .off();
-  collision.off();
-  floods   .off();
+  lights.allOff();
 }
 
-void updateAll() {
-  taxi     .update();
-  position .update();
-  collision.update();
-  floods   .update();
+void updateAll(const uint32_t now) {
+  updateIfDue(lights, now);
 }
 
 void allOff() {
@@ -99,10 +93,10 @@ void allOff() {
 
 // -------------------- Time of Day Settings ----------------
 void setEvening() {
-  taxi     .on();
-  position .flash();
-  collision.flash();
-  floods   .on();
+  lights.on   (taxi);
+  lights.flash(position);
+  lights.flash(collision);
+  lights.on   (floods);
 }
 
 void setNight() {
@@ -110,24 +104,24 @@ void setNight() {
 }
 
 void setPreDawn() {
-  taxi     .on();
-  position .flash();
-  collision.flash();
-  floods   .on();
+  lights.on   (taxi);
+  lights.flash(position);
+  lights.flash(collision);
+  lights.on   (floods);
 }
 
 void setMorning() {
-  taxi     .on();
-  position .flash();
-  collision.flash();
-  floods   .on();
+  lights.on   (taxi);
+  lights.flash(position);
+  lights.flash(collision);
+  lights.on   (floods);
 }
 
 void setDay() {
-  taxi     .flash();
-  position .flash();
-  collision.flash();
-  floods   .off();
+  lights.flash(taxi);
+  lights.flash(position);
+  lights.flash(collision);
+  lights.off  (floods);
 }
 
 void processKey(const uint32_t key) {
@@ -135,83 +129,56 @@ void processKey(const uint32_t key) {
   Serial.println(key, HEX);
   switch (key) {
   case '0':
-  case RC65X_KEY0:
-  case RC65X_KEYDOWN: // Control wheel down
-  case RM_YD065_KEY0:
-  case RM_YD065_KEYDOWN:
     Serial.print(F("Got remote \"0\"\n"));
     setToMode(MODE_OVERRIDE);
     allOff();
     break;
   // case '1':
-  // case RC65X_KEY1:
-  // case RM_YD065_KEY1:
   //   Serial.print(F("Got remote \"1\"\n"));
   //   setToMode(MODE_OVERRIDE);
   //   something.toggle();
   //   break;
   case '2':
-  case RC65X_KEY2:
-  case RM_YD065_KEY2:
     Serial.print(F("Got remote \"2\"\n"));
     setToMode(MODE_OVERRIDE);
-    taxi.toggle();
+    lights.toggle(taxi);
     break;
   // case '3':
-  // case RC65X_KEY3:
-  // case RM_YD065_KEY3:
   //   Serial.print(F("Got remote \"3\"\n"));
   //   setToMode(MODE_OVERRIDE);
   //   something.toggle();
   //   break;
   // case '4':
-  // case RC65X_KEY4:
-  // case RM_YD065_KEY4:
   //   Serial.print(F("Got remote \"4\"\n"));
   //   setToMode(MODE_OVERRIDE);
   //   something.toggle();
   //   break;
   case '5':
-  case RC65X_KEY5:
-  case RM_YD065_KEY5:
     Serial.print(F("Got remote \"5\"\n"));
     setToMode(MODE_OVERRIDE);
-    position.toggle();
+    lights.toggle(position);
     break;
   case '6':
-  case RC65X_KEY6:
-  case RM_YD065_KEY6:
     Serial.print(F("Got remote \"6\"\n"));
     setToMode(MODE_OVERRIDE);
-    collision.toggle();
+    lights.toggle(collision);
     break;
   case '7':
-  case RC65X_KEY7:
-  case RM_YD065_KEY7:
     Serial.print(F("Got remote \"7\"\n"));
     setToMode(MODE_OVERRIDE);
-    floods.toggle();
+    lights.toggle(floods);
     break;
   case 'B':
-  case RC65X_KEYRED:
-  case RM_YD065_KEYRED:
     Serial.print(F("Got remote \"B\"\n"));
     setToMode(MODE_BATTERYLOW);
     break;
   case '8':
-  case RC65X_KEY8:
-  case RC65X_KEYUP: // Control wheel up
-  case RM_YD065_KEY8:
-  case RM_YD065_KEYUP:
+  case '^': // Control wheel up
     Serial.print(F("Got remote \"8\"\n"));
     setToMode(MODE_OVERRIDE);
     allLightsOn();
     break;
   case 'P':
-  case RC65X_KEYPLAY:
-  case RC65X_KEYSELECT:
-  case RM_YD065_KEYPLAY:
-  case RM_YD065_KEYOK:
     Serial.print(F("Got remote \"P\"\n"));
     const uint16_t lightLevel = hw.photocell2();
     const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel);
@@ -222,17 +189,20 @@ void processKey(const uint32_t key) {
 
 void serialPrintCustomStatus()
 {
-  //                              1     2    3    4       5         66        7
-  serialPrintCustomStatusDefault(NULL,&taxi,NULL,NULL,&position,&collision,&floods);
+  const int8_t lightModes[7] = {-1,                                     // 1
+                                int8_t(lights.getLightMode(taxi)),      // 2
+                                -1, -1,                                 // 3, 4
+                                int8_t(lights.getLightMode(position)),  // 5
+                                int8_t(lights.getLightMode(collision)), // 6
+                                int8_t(lights.getLightMode(floods))};   // 7
+  serialPrintCustomStatusModes(lightModes);
 }
 
 void setupLightingAndMotorChannels()
 {
-  taxi     .setup(hw.o2, ON, 1, taxiDayOnLengths, taxiDayDecayLengths,
-                  taxiDayMaxLightLevels, taxiDayTauInMilliseconds);
-  position .setup(hw.o5, ON, 1, positionOnLengths, positionDecayLengths,
-                  positionMaxLightLevels, positionTauInMilliseconds);
-  collision.setup(hw.o6, ON, 2, collisionOnLengths, collisionDecayLengths,
-                  collisionMaxLightLevels, collisionTauInMilliseconds);
-  floods   .setup(hw.o7, ON);
+  lights.setup();
+  taxi      = lights.addDecayLight(hw.o2, ON, 1, taxiDayIntervals);
+  position  = lights.addDecayLight(hw.o5, ON, 1, positionIntervals);
+  collision = lights.addDecayLight(hw.o6, ON, 2, collisionIntervals);
+  floods    = lights.addLight     (hw.o7, ON);
 }
@@ -20,11 +20,28 @@
 #include "IRremote.h"
 #include "IRremoteInt.h"
 
-// Provides ISR
-#include <avr/interrupt.h>
-
 volatile irparams_t irparams;
 
+// Use FNV hash algorithm: http://isthe.com/chongo/tech/comp/fnv/#FNV-param
+#define FNV_PRIME_32 16777619
+#define FNV_BASIS_32 2166136261
+
+// Compare two tick values, returning 0 if newval is shorter,
+// 1 if newval is equal, and 2 if newval is longer
+// Use a tolerance of 20%.  newval < oldval*.8 is worked out as
+// 5*newval < 4*oldval, so there is no float maths in the interrupt handler.
+static inline uint8_t compareTicks(unsigned int oldval, unsigned int newval) {
+  if (5UL*newval < 4UL*oldval) {
+    return 0;
+  } 
+  else if (5UL*oldval < 4UL*newval) {
+    return 2;
+  } 
+  else {
+    return 1;
+  }
+}
+
 // These versions of MATCH, MATCH_MARK, and MATCH_SPACE are only for debugging.
 // To use them, set DEBUG in IRremoteInt.h
 // Normally macros are used for efficiency
@@ -73,6 +90,7 @@ int MATCH_SPACE(int measured_ticks, int desired_us) {return MATCH(measured_ticks
 // Debugging versions are in IRremote.cpp
 #endif
 
+#ifdef IR_SEND
 void IRsend::sendNEC(unsigned long data, int nbits)
 {
   enableIROut(38);
@@ -289,6 +307,7 @@ void IRsend::enableIROut(int khz) {
   // The top value for the timer.  The modulation frequency will be SYSCLOCK / 2 / OCR2A.
   TIMER_CONFIG_KHZ(khz);
 }
+#endif
 
 IRrecv::IRrecv(int recvpin)
 {
@@ -298,26 +317,17 @@ IRrecv::IRrecv(int recvpin)
 
 // initialization
 void IRrecv::enableIRIn() {
-  cli();
-  // setup pulse clock timer interrupt
-  //Prescale /8 (16M/8 = 0.5 microseconds per tick)
-  // Therefore, the timer interval can range from 0.5 to 128 microseconds
-  // depending on the reset value (255 to 0)
-  TIMER_CONFIG_NORMAL();
-
-  //Timer2 Overflow Interrupt Enable
-  TIMER_ENABLE_INTR;
-
-  TIMER_RESET;
-
-  sei();  // enable interrupts
-
   // initialize state machine variables
   irparams.rcvstate = STATE_IDLE;
   irparams.rawlen = 0;
+  irparams.lastEdge = micros();
 
   // set pin modes
   pinMode(irparams.recvpin, INPUT);
+
+  // Interrupt on every change of the receiver pin.  No timer is used, so
+  // the PWM outputs on the timer's pins keep working.
+  attachInterrupt(IR_RECV_INTERRUPT(irparams.recvpin), irRecvEdge, CHANGE);
 }
 
 // enable/disable blinking of pin 13 on IR processing
@@ -328,69 +338,242 @@ void IRrecv::blink13(int blinkflag)
     pinMode(BLINKLED, OUTPUT);
 }
 
-// TIMER2 interrupt code to collect raw data.
-// Widths of alternating SPACE, MARK are recorded in rawbuf.
-// Recorded in ticks of 50 microseconds.
+#ifdef IR_STREAMING
+// Decode the width of entry rawlen, a MARK if rawlen is odd and a SPACE if
+// it is even, into irparams.  Does what decodeNEC(), decodeSony() and
+// decodeHash() do with the whole of rawbuf, one entry at a time.
+static void irRecord(const unsigned int ticks)
+{
+  const uint8_t i = irparams.rawlen++;
+  if (i == 0) {
+    // Gap before the transmission
+    irparams.necstate   = NEC_STREAM_CODE;
+    irparams.necdata    = 0;
+    irparams.sonystate  = SONY_STREAM_CODE;
+    irparams.sonybits   = 0;
+    irparams.sonydata   = 0;
+    irparams.sonyrepeat = ticks < SONY_DOUBLE_SPACE_USECS;
+    irparams.hash       = FNV_BASIS_32;
+    irparams.hashok     = true;
+    return;
+  }
+
+  // Flicker has no leader MARK.  A burst with a NEC or Sony header is
+  // theirs, and garbled or cut short if they do not decode it.  The hash
+  // should not make a key of either.
+  if ((i == 1 && ticks < HASH_MIN_LEADER/USECPERTICK) ||
+      (i == 3 && (irparams.necstate  != NEC_STREAM_FAILED ||
+                  irparams.sonystate != SONY_STREAM_FAILED))) {
+    irparams.hashok = false;
+  }
+
+  // decodeHash(): compare each entry with the one two before it
+  if (i >= 3) {
+    irparams.hash = (irparams.hash * FNV_PRIME_32) ^
+      compareTicks(irparams.lastwidth[i & 1], ticks);
+  }
+  irparams.lastwidth[i & 1] = ticks;
+
+  // decodeSony(): header MARK, then SPACE and MARK pairs with the bit in
+  // the MARK, until a SPACE that does not match
+  if (irparams.sonystate == SONY_STREAM_CODE) {
+    if (i == 1) {
+      if (!TICKS_MATCH_MARK(ticks, SONY_HDR_MARK)) {
+        irparams.sonystate = SONY_STREAM_FAILED;
+      }
+    }
+    else if (!(i & 1)) {
+      if (!TICKS_MATCH_SPACE(ticks, SONY_HDR_SPACE)) {
+        irparams.sonystate = (irparams.sonybits >= SONY_BITS)
+          ? SONY_STREAM_DONE : SONY_STREAM_FAILED;
+      }
+    }
+    else if (TICKS_MATCH_MARK(ticks, SONY_ONE_MARK)) {
+      irparams.sonydata = (irparams.sonydata << 1) | 1;
+      irparams.sonybits++;
+    }
+    else if (TICKS_MATCH_MARK(ticks, SONY_ZERO_MARK)) {
+      irparams.sonydata <<= 1;
+      irparams.sonybits++;
+    }
+    else {
+      irparams.sonystate = SONY_STREAM_FAILED;
+    }
+  }
+
+  // decodeNEC(): header MARK and SPACE, then NEC_BITS MARK and SPACE pairs.
+  // A repeat is the header MARK, a short SPACE and one MARK.
+  uint8_t necstate = irparams.necstate;
+  if (necstate == NEC_STREAM_FAILED || i > 2 * NEC_BITS + 2) {
+    return;
+  }
+  if (i == 1) {
+    if (!TICKS_MATCH_MARK(ticks, NEC_HDR_MARK)) {
+      necstate = NEC_STREAM_FAILED;
+    }
+  }
+  else if (i == 2) {
+    if (TICKS_MATCH_SPACE(ticks, NEC_RPT_SPACE)) {
+      necstate = NEC_STREAM_REPEAT;
+    }
+    else if (!TICKS_MATCH_SPACE(ticks, NEC_HDR_SPACE)) {
+      necstate = NEC_STREAM_FAILED;
+    }
+  }
+  else if (i & 1) {
+    if (!TICKS_MATCH_MARK(ticks, NEC_BIT_MARK)) {
+      necstate = NEC_STREAM_FAILED;
+    }
+  }
+  else if (necstate == NEC_STREAM_REPEAT) {
+    // A repeat is only 4 entries long
+    necstate = NEC_STREAM_FAILED;
+  }
+  else if (TICKS_MATCH_SPACE(ticks, NEC_ONE_SPACE)) {
+    irparams.necdata = (irparams.necdata << 1) | 1;
+  } 
+  else if (TICKS_MATCH_SPACE(ticks, NEC_ZERO_SPACE)) {
+    irparams.necdata <<= 1;
+  } 
+  else {
+    necstate = NEC_STREAM_FAILED;
+  }
+  irparams.necstate = necstate;
+}
+
+// The transmission has ended.  Queue what decode() used to make of it, and
+// wait for the next one.  Called from the interrupt handler, or with
+// interrupts off, so there is only ever one writer to the queue.
+static void irRecvEnd()
+{
+  unsigned long value;
+  int8_t  type = NEC;
+  uint8_t bits = 0;
+  if (irparams.necstate == NEC_STREAM_REPEAT && irparams.rawlen == 4) {
+    value = REPEAT;
+  }
+  else if (irparams.necstate == NEC_STREAM_CODE &&
+           irparams.rawlen >= 2 * NEC_BITS + 4) {
+    value = irparams.necdata;
+    bits  = NEC_BITS;
+  }
+  else if (irparams.sonystate != SONY_STREAM_FAILED &&
+           irparams.sonybits >= SONY_BITS) {
+    // Sony remotes send a held key's code again straight after, which
+    // decodeSony() takes as a repeat
+    type = SONY;
+    if (irparams.sonyrepeat) {
+      value = REPEAT;
+    }
+    else {
+      value = irparams.sonydata;
+      bits  = irparams.sonybits;
+    }
+  }
+  else if (irparams.hashok && irparams.rawlen >= HASH_MIN_ENTRIES) {
+    // As decodeHash()
+    value = irparams.hash;
+    type  = UNKNOWN;
+    bits  = 32;
+  }
+  else {
+    type = 0;
+  }
+
+  irparams.endEdge = irparams.lastEdge;
+  const uint8_t head = irparams.queueHead;
+  const uint8_t next = (head + 1) & (IR_QUEUE_SIZE - 1);
+  // When the queue is full the newest code is dropped
+  if (type && next != irparams.queueTail) {
+    irparams.queueValue[head] = value;
+    irparams.queueType[head]  = type;
+    irparams.queueBits[head]  = bits;
+    irparams.queueTime[head]  = irparams.endEdge;
+    irparams.queueHead = next;
+  }
+  irparams.rawlen = 0;
+  irparams.rcvstate = STATE_IDLE;
+}
+#else
+static inline void irRecord(const unsigned int ticks)
+{
+  irparams.rawbuf[irparams.rawlen++] = ticks;
+}
+
+// The transmission has ended, wait for decode() and resume()
+static inline void irRecvEnd()
+{
+  irparams.endEdge = irparams.lastEdge;
+  irparams.rcvstate = STATE_STOP;
+}
+#endif
+
+// Receiver pin change interrupt, to collect raw data.
+// Widths of alternating SPACE, MARK are recorded in rawbuf, or decoded
+// straight away with IR_STREAMING, see irRecord().
+// Recorded in ticks of 50 microseconds, timed with micros() between edges.
 // rawlen counts the number of entries recorded so far.
 // First entry is the SPACE between transmissions.
-// As soon as a SPACE gets long, ready is set, state switches to IDLE, timing of SPACE continues.
-// As soon as first MARK arrives, gap width is recorded, ready is cleared, and new logging starts
-ISR(TIMER_INTR_NAME)
+// A SPACE longer than a gap ends the transmission.  As no edge comes at
+// the end of it, decode() also checks for this, see irRecvGapEnded().
+// As soon as first MARK after a gap arrives, gap width is recorded and new
+// logging starts.
+void irRecvEdge()
 {
-  TIMER_RESET;
+  const unsigned long now = micros();
+  const unsigned long elapsed = now - irparams.lastEdge;
 
+  // Level the pin changed to, so the end of the MARK or SPACE timed
   uint8_t irdata = (uint8_t)digitalRead(irparams.recvpin);
 
-  irparams.timer++; // One more 50us tick
+  const unsigned int ticks = (elapsed >= 0xFFFFUL*USECPERTICK) ? 0xFFFF
+    : (unsigned int)(elapsed/USECPERTICK);
+
   if (irparams.rawlen >= RAWBUF) {
     // Buffer overflow
-    irparams.rcvstate = STATE_STOP;
+#ifdef IR_STREAMING
+    irparams.hashok = false; // No gap seen at the end, so not a whole code
+#endif
+    irRecvEnd();
   }
   switch(irparams.rcvstate) {
   case STATE_IDLE: // In the middle of a gap
-    if (irdata == MARK) {
-      if (irparams.timer < GAP_TICKS) {
-        // Not big enough to be a gap.
-        irparams.timer = 0;
-      } 
-      else {
-        // gap just ended, record duration and start recording transmission
-        irparams.rawlen = 0;
-        irparams.rawbuf[irparams.rawlen++] = irparams.timer;
-        irparams.timer = 0;
-        irparams.rcvstate = STATE_MARK;
-      }
+    if (irdata == MARK && ticks >= GAP_TICKS) {
+      // gap just ended, record duration and start recording transmission
+      irparams.rawlen = 0;
+      irRecord(ticks);
+      irparams.rcvstate = STATE_MARK;
     }
     break;
   case STATE_MARK: // timing MARK
     if (irdata == SPACE) {   // MARK ended, record time
-      irparams.rawbuf[irparams.rawlen++] = irparams.timer;
-      irparams.timer = 0;
+      irRecord(ticks);
       irparams.rcvstate = STATE_SPACE;
     }
     break;
   case STATE_SPACE: // timing SPACE
-    if (irdata == MARK) { // SPACE just ended, record it
-      irparams.rawbuf[irparams.rawlen++] = irparams.timer;
-      irparams.timer = 0;
-      irparams.rcvstate = STATE_MARK;
-    } 
-    else { // SPACE
-      if (irparams.timer > GAP_TICKS) {
+    if (irdata == MARK) {
+      if (ticks > GAP_TICKS) {
         // big SPACE, indicates gap between codes
-        // Mark current code as ready for processing
-        // Switch to STOP
-        // Don't reset timer; keep counting space width
-        irparams.rcvstate = STATE_STOP;
-      } 
+        // The current code has ended
+        irRecvEnd();
+        if (irparams.rcvstate == STATE_IDLE) {
+          // Nothing to wait for, this MARK starts the next code
+          irRecord(ticks);
+          irparams.rcvstate = STATE_MARK;
+        }
+      }
+      else { // SPACE just ended, record it
+        irRecord(ticks);
+        irparams.rcvstate = STATE_MARK;
+      }
     }
     break;
-  case STATE_STOP: // waiting, measuring gap
-    if (irdata == MARK) { // reset gap timer
-      irparams.timer = 0;
-    }
+  case STATE_STOP: // waiting for decode() and resume()
     break;
   }
+  // After the switch, so a code ending at this edge ends at the one before
+  irparams.lastEdge = now;
 
   if (irparams.blinkflag) {
     if (irdata == MARK) {
@@ -402,9 +585,27 @@ ISR(TIMER_INTR_NAME)
   }
 }
 
+// The last SPACE of a transmission has no edge at its end, so the main
+// loop finds it has become a gap
+static void irRecvGapEnded()
+{
+  if (irparams.rcvstate != STATE_SPACE) {
+    return;
+  }
+  uint8_t oldSREG = SREG;
+  cli();
+  if (irparams.rcvstate == STATE_SPACE &&
+      micros() - irparams.lastEdge > _GAP) {
+    irRecvEnd();
+  }
+  SREG = oldSREG;
+}
+
 void IRrecv::resume() {
+#ifndef IR_STREAMING
   irparams.rcvstate = STATE_IDLE;
   irparams.rawlen = 0;
+#endif
 }
 
 
@@ -413,71 +614,145 @@ void IRrecv::resume() {
 // Returns 0 if no data ready, 1 if data ready.
 // Results of decoding are stored in results
 int IRrecv::decode(decode_results *results) {
+  irRecvGapEnded();
+#ifdef IR_STREAMING
+  // The interrupt handler has already decoded it, see irRecvEnd()
+  results->rawbuf = NULL;
+  results->rawlen = 0;
+  const uint8_t tail = irparams.queueTail;
+  if (tail == irparams.queueHead) {
+    return ERR;
+  }
+  results->value = irparams.queueValue[tail];
+  results->decode_type = irparams.queueType[tail];
+  results->bits = irparams.queueBits[tail];
+  results->time = irparams.queueTime[tail];
+  irparams.queueTail = (tail + 1) & (IR_QUEUE_SIZE - 1);
+  return DECODED;
+#else
   results->rawbuf = irparams.rawbuf;
   results->rawlen = irparams.rawlen;
   if (irparams.rcvstate != STATE_STOP) {
     return ERR;
   }
+  results->time = irparams.endEdge;
+  // Only the decoders whose own first checks, on the leading mark and the
+  // length, would pass are called.  The checks are against limits worked
+  // out at compile time, so most decoders are skipped without any of the
+  // float maths in MATCH(), and the results are as if all were tried.
+  const unsigned int gap = results->rawbuf[0];
+  const unsigned int leader = results->rawbuf[1];
+  const int len = results->rawlen;
+#ifdef IR_DECODE_NEC
+  if (TICKS_MATCH_MARK(leader, NEC_HDR_MARK) &&
+      (len == 4 || len >= 2 * NEC_BITS + 4)) {
 #ifdef DEBUG
-  Serial.println("Attempting NEC decode");
+    Serial.println("Attempting NEC decode");
 #endif
-  if (decodeNEC(results)) {
-    return DECODED;
+    if (decodeNEC(results)) {
+      return DECODED;
+    }
   }
+#endif
+#ifdef IR_DECODE_SONY
+  if (len >= 2 * SONY_BITS + 2 &&
+      (gap < SONY_DOUBLE_SPACE_USECS || TICKS_MATCH_MARK(leader, SONY_HDR_MARK))) {
 #ifdef DEBUG
-  Serial.println("Attempting Sony decode");
+    Serial.println("Attempting Sony decode");
 #endif
-  if (decodeSony(results)) {
-    return DECODED;
+    if (decodeSony(results)) {
+      return DECODED;
+    }
   }
+#endif
+#ifdef IR_DECODE_SANYO
+  if (len >= 2 * SANYO_BITS + 2 &&
+      (gap < SANYO_DOUBLE_SPACE_USECS || TICKS_MATCH_MARK(leader, SANYO_HDR_MARK))) {
 #ifdef DEBUG
-  Serial.println("Attempting Sanyo decode");
+    Serial.println("Attempting Sanyo decode");
 #endif
-  if (decodeSanyo(results)) {
-    return DECODED;
+    if (decodeSanyo(results)) {
+      return DECODED;
+    }
   }
+#endif
+#ifdef IR_DECODE_MITSUBISHI
+  // decodeMitsubishi() matches its "space" as a mark
+  if (len >= 2 * MITSUBISHI_BITS + 2 &&
+      TICKS_MATCH_MARK(leader, MITSUBISHI_HDR_SPACE)) {
 #ifdef DEBUG
-  Serial.println("Attempting Mitsubishi decode");
+    Serial.println("Attempting Mitsubishi decode");
 #endif
-  if (decodeMitsubishi(results)) {
-    return DECODED;
+    if (decodeMitsubishi(results)) {
+      return DECODED;
+    }
   }
+#endif
+#ifdef IR_DECODE_RC5
+  // getRClevel() takes a first mark of one to three T1
+  if (len >= MIN_RC5_SAMPLES + 2 &&
+      leader >= TICKS_LOW(RC5_T1 + MARK_EXCESS) &&
+      leader <= TICKS_HIGH(3 * RC5_T1 + MARK_EXCESS)) {
 #ifdef DEBUG
-  Serial.println("Attempting RC5 decode");
-#endif  
-  if (decodeRC5(results)) {
-    return DECODED;
+    Serial.println("Attempting RC5 decode");
+#endif
+    if (decodeRC5(results)) {
+      return DECODED;
+    }
   }
+#endif
+#ifdef IR_DECODE_RC6
+  if (len >= MIN_RC6_SAMPLES && TICKS_MATCH_MARK(leader, RC6_HDR_MARK)) {
 #ifdef DEBUG
-  Serial.println("Attempting RC6 decode");
-#endif 
-  if (decodeRC6(results)) {
-    return DECODED;
+    Serial.println("Attempting RC6 decode");
+#endif
+    if (decodeRC6(results)) {
+      return DECODED;
+    }
   }
+#endif
+#ifdef IR_DECODE_PANASONIC
+  if (TICKS_MATCH_MARK(leader, PANASONIC_HDR_MARK)) {
 #ifdef DEBUG
     Serial.println("Attempting Panasonic decode");
-#endif 
+#endif
     if (decodePanasonic(results)) {
-        return DECODED;
+      return DECODED;
     }
+  }
+#endif
+#ifdef IR_DECODE_LG
+  if (len >= 2 * LG_BITS + 1 && TICKS_MATCH_MARK(leader, LG_HDR_MARK)) {
 #ifdef DEBUG
     Serial.println("Attempting LG decode");
-#endif 
+#endif
     if (decodeLG(results)) {
-        return DECODED;
+      return DECODED;
     }
+  }
+#endif
+#ifdef IR_DECODE_JVC
+  if ((len == 34 && TICKS_MATCH_MARK(leader, JVC_BIT_MARK)) ||
+      (len >= 2 * JVC_BITS + 1 && TICKS_MATCH_MARK(leader, JVC_HDR_MARK))) {
 #ifdef DEBUG
     Serial.println("Attempting JVC decode");
-#endif 
+#endif
     if (decodeJVC(results)) {
-        return DECODED;
+      return DECODED;
     }
+  }
+#endif
+#ifdef IR_DECODE_SAMSUNG
+  if (TICKS_MATCH_MARK(leader, SAMSUNG_HDR_MARK) &&
+      (len == 4 || len >= 2 * SAMSUNG_BITS + 4)) {
 #ifdef DEBUG
-  Serial.println("Attempting SAMSUNG decode");
+    Serial.println("Attempting SAMSUNG decode");
 #endif
-  if (decodeSAMSUNG(results)) {
-    return DECODED;
+    if (decodeSAMSUNG(results)) {
+      return DECODED;
+    }
   }
+#endif
   // decodeHash returns a hash on any input.
   // Thus, it needs to be last in the list.
   // If you add any decodes, add them before this.
@@ -487,8 +762,10 @@ int IRrecv::decode(decode_results *results) {
   // Throw away and start over
   resume();
   return ERR;
+#endif
 }
 
+#ifdef IR_DECODE_NEC
 // NECs have a repeat only 4 items long
 long IRrecv::decodeNEC(decode_results *results) {
   long data = 0;
@@ -537,7 +814,9 @@ long IRrecv::decodeNEC(decode_results *results) {
   results->decode_type = NEC;
   return DECODED;
 }
+#endif
 
+#ifdef IR_DECODE_SONY
 long IRrecv::decodeSony(decode_results *results) {
   long data = 0;
   if (irparams.rawlen < 2 * SONY_BITS + 2) {
@@ -589,7 +868,9 @@ long IRrecv::decodeSony(decode_results *results) {
   results->decode_type = SONY;
   return DECODED;
 }
+#endif
 
+#ifdef IR_DECODE_SANYO
 // I think this is a Sanyo decoder - serial = SA 8650B
 // Looks like Sony except for timings, 48 chars of data and time/space different
 long IRrecv::decodeSanyo(decode_results *results) {
@@ -653,7 +934,9 @@ long IRrecv::decodeSanyo(decode_results *results) {
   results->decode_type = SANYO;
   return DECODED;
 }
+#endif
 
+#ifdef IR_DECODE_MITSUBISHI
 // Looks like Sony except for timings, 48 chars of data and time/space different
 long IRrecv::decodeMitsubishi(decode_results *results) {
   // Serial.print("?!? decoding Mitsubishi:");Serial.print(irparams.rawlen); Serial.print(" want "); Serial.println( 2 * MITSUBISHI_BITS + 2);
@@ -717,8 +1000,10 @@ long IRrecv::decodeMitsubishi(decode_results *results) {
   results->decode_type = MITSUBISHI;
   return DECODED;
 }
+#endif
 
 
+#if defined(IR_DECODE_RC5) || defined(IR_DECODE_RC6)
 // Gets one undecoded level at a time from the raw buffer.
 // The RC5/6 decoding is easier if the data is broken into time intervals.
 // E.g. if the buffer has MARK for 2 time intervals and SPACE for 1,
@@ -764,7 +1049,9 @@ int IRrecv::getRClevel(decode_results *results, int *offset, int *used, int t1)
 #endif
   return val;   
 }
+#endif
 
+#ifdef IR_DECODE_RC5
 long IRrecv::decodeRC5(decode_results *results) {
   if (irparams.rawlen < MIN_RC5_SAMPLES + 2) {
     return ERR;
@@ -799,7 +1086,9 @@ long IRrecv::decodeRC5(decode_results *results) {
   results->decode_type = RC5;
   return DECODED;
 }
+#endif
 
+#ifdef IR_DECODE_RC6
 long IRrecv::decodeRC6(decode_results *results) {
   if (results->rawlen < MIN_RC6_SAMPLES) {
     return ERR;
@@ -850,6 +1139,9 @@ long IRrecv::decodeRC6(decode_results *results) {
   results->decode_type = RC6;
   return DECODED;
 }
+#endif
+
+#ifdef IR_DECODE_PANASONIC
 long IRrecv::decodePanasonic(decode_results *results) {
     unsigned long long data = 0;
     int offset = 1;
@@ -883,7 +1175,9 @@ long IRrecv::decodePanasonic(decode_results *results) {
     results->bits = PANASONIC_BITS;
     return DECODED;
 }
+#endif
 
+#ifdef IR_DECODE_LG
 long IRrecv::decodeLG(decode_results *results) {
     long data = 0;
     int offset = 1; // Skip first space
@@ -927,8 +1221,10 @@ long IRrecv::decodeLG(decode_results *results) {
     results->decode_type = LG;
     return DECODED;
 }
+#endif
 
 
+#ifdef IR_DECODE_JVC
 long IRrecv::decodeJVC(decode_results *results) {
     long data = 0;
     int offset = 1; // Skip first space
@@ -980,7 +1276,9 @@ long IRrecv::decodeJVC(decode_results *results) {
     results->decode_type = JVC;
     return DECODED;
 }
+#endif
 
+#ifdef IR_DECODE_SAMSUNG
 // SAMSUNGs have a repeat only 4 items long
 long IRrecv::decodeSAMSUNG(decode_results *results) {
   long data = 0;
@@ -1029,7 +1327,9 @@ long IRrecv::decodeSAMSUNG(decode_results *results) {
   results->decode_type = SAMSUNG;
   return DECODED;
 }
+#endif
 
+#ifndef IR_STREAMING
 /* -----------------------------------------------------------------------
  * hashdecode - decode an arbitrary IR code.
  * Instead of decoding using a standard encoding scheme
@@ -1044,25 +1344,11 @@ long IRrecv::decodeSAMSUNG(decode_results *results) {
  * http://arcfn.com/2010/01/using-arbitrary-remotes-with-arduino.html
  */
 
-// Compare two tick values, returning 0 if newval is shorter,
-// 1 if newval is equal, and 2 if newval is longer
-// Use a tolerance of 20%
+// See compareTicks()
 int IRrecv::compare(unsigned int oldval, unsigned int newval) {
-  if (newval < oldval * .8) {
-    return 0;
-  } 
-  else if (oldval < newval * .8) {
-    return 2;
-  } 
-  else {
-    return 1;
-  }
+  return compareTicks(oldval, newval);
 }
 
-// Use FNV hash algorithm: http://isthe.com/chongo/tech/comp/fnv/#FNV-param
-#define FNV_PRIME_32 16777619
-#define FNV_BASIS_32 2166136261
-
 /* Converts the raw code values into a 32-bit hash code.
  * Hopefully this code is unique for each button.
  * This isn't a "real" decoding, just an arbitrary value.
@@ -1083,7 +1369,9 @@ long IRrecv::decodeHash(decode_results *results) {
   results->decode_type = UNKNOWN;
   return DECODED;
 }
+#endif
 
+#ifdef IR_SEND
 /* Sharp and DISH support by Todd Treece ( http://unionbridge.org/design/ircommand )
 
 The Dish send function needs to be repeated 4 times, and the Sharp function
@@ -1157,3 +1445,4 @@ void IRsend::sendDISH(unsigned long data, int nbits)
     data <<= 1;
   }
 }
+#endif
@@ -23,6 +23,30 @@
 // methods virtual, which will be slightly slower, which is why it is optional.
 // #define DEBUG
 // #define TEST
+// If IR_STREAMING is defined, the receiver interrupt decodes NEC and Sony,
+// and hashes anything else as decodeHash() does, a width at a time as the
+// edges come in.  No raw buffer is kept, and no other protocol is decoded.
+// Our remotes, see RC65X.h (hashed) and RMYD065.h (Sony), need nothing
+// else.  Codes are queued for decode() and the receiver carries straight
+// on, so resume() is not needed and codes that end while the sketch is
+// busy are not lost.
+#define IR_STREAMING
+// Without IR_STREAMING, decode() tries each protocol defined here in turn.
+// Leave out the ones your remotes don't use to save their code space.
+#ifndef IR_STREAMING
+#define IR_DECODE_NEC
+#define IR_DECODE_SONY
+#define IR_DECODE_SANYO
+#define IR_DECODE_MITSUBISHI
+#define IR_DECODE_RC5
+#define IR_DECODE_RC6
+#define IR_DECODE_PANASONIC
+#define IR_DECODE_LG
+#define IR_DECODE_JVC
+#define IR_DECODE_SAMSUNG
+#endif
+// If IR_SEND is defined, IRsend is built.  The controllers only receive.
+// #define IR_SEND
 
 // Results returned from the decoder
 class decode_results {
@@ -31,8 +55,9 @@ public:
   unsigned int panasonicAddress; // This is only used for decoding Panasonic data
   unsigned long value; // Decoded value
   int bits; // Number of bits in decoded value
-  volatile unsigned int *rawbuf; // Raw intervals in .5 us ticks
-  int rawlen; // Number of records in rawbuf.
+  volatile unsigned int *rawbuf; // Raw intervals in .5 us ticks, NULL with IR_STREAMING
+  int rawlen; // Number of records in rawbuf, 0 with IR_STREAMING
+  unsigned long time; // micros() at the last edge of the code
 };
 
 // Values for decode_type
@@ -64,19 +89,43 @@ public:
   void resume();
 private:
   // These are called by decode
+#if defined(IR_DECODE_RC5) || defined(IR_DECODE_RC6)
   int getRClevel(decode_results *results, int *offset, int *used, int t1);
+#endif
+#ifdef IR_DECODE_NEC
   long decodeNEC(decode_results *results);
+#endif
+#ifdef IR_DECODE_SONY
   long decodeSony(decode_results *results);
+#endif
+#ifdef IR_DECODE_SANYO
   long decodeSanyo(decode_results *results);
+#endif
+#ifdef IR_DECODE_MITSUBISHI
   long decodeMitsubishi(decode_results *results);
+#endif
+#ifdef IR_DECODE_RC5
   long decodeRC5(decode_results *results);
+#endif
+#ifdef IR_DECODE_RC6
   long decodeRC6(decode_results *results);
+#endif
+#ifdef IR_DECODE_PANASONIC
   long decodePanasonic(decode_results *results);
+#endif
+#ifdef IR_DECODE_LG
   long decodeLG(decode_results *results);
+#endif
+#ifdef IR_DECODE_JVC
   long decodeJVC(decode_results *results);
+#endif
+#ifdef IR_DECODE_SAMSUNG
   long decodeSAMSUNG(decode_results *results);
+#endif
+#ifndef IR_STREAMING
   long decodeHash(decode_results *results);
   int compare(unsigned int oldval, unsigned int newval);
+#endif
 
 } 
 ;
@@ -88,6 +137,7 @@ private:
 #define VIRTUAL
 #endif
 
+#ifdef IR_SEND
 class IRsend
 {
 public:
@@ -111,10 +161,11 @@ public:
   VIRTUAL void space(int usec);
 }
 ;
+#endif
 
 // Some useful constants
 
-#define USECPERTICK 50  // microseconds per clock interrupt tick
+#define USECPERTICK 50  // microseconds per rawbuf tick
 #define RAWBUF 100 // Length of raw duration buffer
 
 // Marks tend to be 100us too long, and spaces 100us too short
@@ -16,7 +16,15 @@
 #ifndef IRremoteint_h
 #define IRremoteint_h
 
-#if defined(ARDUINO) && ARDUINO >= 100
+#if defined(DOING_UNIT_TESTING)
+// Host builds, see tests/ir_benchmark.cpp.  arduino-mock has no interrupts
+// to turn off or attach to.
+#include "Arduino.h"
+#define CHANGE 1
+static uint8_t SREG;
+static inline void cli() {}
+static inline void attachInterrupt(uint8_t, void (*)(), int) {}
+#elif defined(ARDUINO) && ARDUINO >= 100
 #include <Arduino.h>
 #else
 #include <WProgram.h>
@@ -27,6 +35,8 @@
 // Uncomment the timer you wish to use on your board.  If you
 // are using another library which uses timer2, you have options
 // to switch IRremote to use a different timer.
+// Only IRsend uses the timer.  IRrecv times the edges of the receiver pin
+// with micros().
 
 // Arduino Mega
 #if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
@@ -187,25 +197,79 @@
 #define TICKS_LOW(us) (int) (((us)*LTOL/USECPERTICK))
 #define TICKS_HIGH(us) (int) (((us)*UTOL/USECPERTICK + 1))
 
+// MATCH_MARK() and MATCH_SPACE() for use in the interrupt handler, with
+// the limits worked out at compile time
+#define TICKS_MATCH(ticks, us) \
+  ((ticks) >= TICKS_LOW(us) && (ticks) <= TICKS_HIGH(us))
+#define TICKS_MATCH_MARK(ticks, us)  TICKS_MATCH(ticks, (us) + MARK_EXCESS)
+#define TICKS_MATCH_SPACE(ticks, us) TICKS_MATCH(ticks, (us) - MARK_EXCESS)
+
 // receiver states
 #define STATE_IDLE     2
 #define STATE_MARK     3
 #define STATE_SPACE    4
 #define STATE_STOP     5
 
+// NEC decoder states, with IR_STREAMING
+#define NEC_STREAM_CODE    0 // Matches a code so far
+#define NEC_STREAM_REPEAT  1 // Matches a repeat so far
+#define NEC_STREAM_FAILED  2 // Not NEC
+// Sony decoder states, with IR_STREAMING
+#define SONY_STREAM_CODE   0 // Matches a code so far
+#define SONY_STREAM_DONE   1 // A code, and anything after it is ignored
+#define SONY_STREAM_FAILED 2 // Not Sony
+#define IR_QUEUE_SIZE      4 // Codes kept for decode(), a power of 2
+// Shortest burst, gap included, taken as an UNKNOWN code by the hash, and
+// its shortest first MARK in microseconds, as the RC65X's 2666.
+// decodeHash() takes any 6 entries, but partial bursts and flicker do too.
+#define HASH_MIN_ENTRIES  24
+#define HASH_MIN_LEADER   2000
+
 // information for the interrupt handler
 typedef struct {
   uint8_t recvpin;           // pin for IR data from detector
   uint8_t rcvstate;          // state machine
   uint8_t blinkflag;         // TRUE to enable blinking of pin 13 on IR processing
-  unsigned int timer;     // state timer, counts 50uS ticks.
+  unsigned long lastEdge;  // micros() at the last change of recvpin
+  unsigned long endEdge;   // lastEdge when the last code ended
+#ifdef IR_STREAMING
+  uint8_t necstate;        // NEC_STREAM_*
+  unsigned long necdata;   // NEC bits so far
+  uint8_t sonystate;       // SONY_STREAM_*
+  uint8_t sonybits;        // Number of Sony bits so far
+  bool sonyrepeat;         // Gap was short enough for decodeSony()'s repeat
+  unsigned long sonydata;  // Sony bits so far
+  unsigned long hash;      // decodeHash() of the widths so far
+  bool hashok;             // Has a leader, and is not NEC, Sony or cut short
+  unsigned int lastwidth[2]; // Last odd and even entry, for the hash
+  // Codes decoded by the interrupt handler, waiting for decode().  Only
+  // the interrupt handler moves queueHead on, and only decode() queueTail,
+  // so neither needs interrupts turned off.
+  unsigned long queueValue[IR_QUEUE_SIZE];
+  int8_t queueType[IR_QUEUE_SIZE]; // NEC, SONY or UNKNOWN
+  uint8_t queueBits[IR_QUEUE_SIZE];
+  unsigned long queueTime[IR_QUEUE_SIZE]; // endEdge of each code
+  uint8_t queueHead;       // Next free entry
+  uint8_t queueTail;       // Next entry for decode()
+#else
   unsigned int rawbuf[RAWBUF]; // raw data
+#endif
   uint8_t rawlen;         // counter of entries in rawbuf
 } 
 irparams_t;
 
 // Defined in IRremote.cpp
 extern volatile irparams_t irparams;
+// Interrupt handler for changes of irparams.recvpin
+void irRecvEdge();
+
+// External interrupt of the receiver pin, which must have one: pins 2 and 3
+// on the ATmega328
+#if defined(digitalPinToInterrupt)
+#define IR_RECV_INTERRUPT(pin) digitalPinToInterrupt(pin)
+#else
+#define IR_RECV_INTERRUPT(pin) ((pin) == 3 ? 1 : 0)
+#endif
 
 // IR detector output is active low
 #define MARK  0
@@ -442,7 +506,11 @@ extern volatile irparams_t irparams;
 
 
 // defines for blinking the LED
-#if defined(CORE_LED0_PIN)
+#if defined(DOING_UNIT_TESTING)
+#define BLINKLED       13
+#define BLINKLED_ON()  (digitalWrite(BLINKLED, HIGH))
+#define BLINKLED_OFF() (digitalWrite(BLINKLED, LOW))
+#elif defined(CORE_LED0_PIN)
 #define BLINKLED       CORE_LED0_PIN
 #define BLINKLED_ON()  (digitalWrite(CORE_LED0_PIN, HIGH))
 #define BLINKLED_OFF() (digitalWrite(CORE_LED0_PIN, LOW))
@@ -17,10 +17,15 @@ void setDay();
 bool overrideBatteryLow();
 void processKey(const uint32_t irKey);
 void processKeyInit(const uint32_t irKey);
+// Called again and again while a key is held, after processKey() for the
+// press, see Lucky7::KEY_HOLD.  Held keys do nothing unless the sketch
+// defines CUSTOM_PROCESSKEYHELD before including aircraft.h, and its own
+// processKeyHeld(), see Adjustable.
+void processKeyHeld(const uint32_t irKey);
 void status(const bool override);
 void setupLightingAndMotorChannels();
 void setBatteryLow();
-void updateAll();
+void updateAll(const uint32_t now);
 void serialPrintCustomStatus();
 // When voltage drops at or below this value, mode will switch to MODE_BATTERYLOW
 float getBatteryLowValue(); 
@@ -82,8 +87,7 @@ TimeOfDay timeOfDay = TimeOfDay();
 FastSlowBlinkingLight blueLight; // Blue light on Aurdino board
 FastSlowBlinkingLight redLight ; // Red light on Aurdino board
 
-void resetTimeoutBatteryLow() {
-  const uint32_t time = millis();
+void resetTimeoutBatteryLow(const uint32_t time) {
   const uint32_t timeoutBatteryLowOld = timeoutBatteryLow;
   timeoutBatteryLow = time + TIMEOUTBATTERYLOW;
   if (timeoutBatteryLow < timeoutBatteryLowOld) {
@@ -91,8 +95,11 @@ void resetTimeoutBatteryLow() {
   }
 }
 
-void resetTimeoutOverride() {
-  const uint32_t time = millis();
+void resetTimeoutBatteryLow() {
+  resetTimeoutBatteryLow(millis());
+}
+
+void resetTimeoutOverride(const uint32_t time) {
   const uint32_t timeoutOverrideOld = timeoutOverride;
   timeoutOverride   = time + TIMEOUTOVERRIDE;
   if (timeoutOverride < timeoutOverrideOld) {
@@ -100,6 +107,10 @@ void resetTimeoutOverride() {
   }
 }
 
+void resetTimeoutOverride() {
+  resetTimeoutOverride(millis());
+}
+
 void setOverride() {
   Serial.println(F("In setOverride()"));
   redLight .setToSlow();
@@ -157,23 +168,30 @@ void setDayInit() {
   setDay();
 }
 
-void updateAllInit() {
-  blueLight.update();
-  redLight .update();
+void updateAllInit(const uint32_t now) {
+  updateIfDue(blueLight, now);
+  updateIfDue(redLight , now);
 
-  updateAll();
+  updateAll(now);
 }
 
-void updateChannels() {
+void updateAllInit() {
+  updateAllInit(millis());
+}
+
+void updateChannels(const uint32_t time) {
   // no need to hammer this
-  const uint32_t time = millis();
   if (time > timeoutUpdateLights) {
     timeoutUpdateLights = time + 10;
     
-    updateAllInit();
+    updateAllInit(time);
   }
 }
 
+void updateChannels() {
+  updateChannels(millis());
+}
+
 
 void setToMode( int targetMode) {
   switch (targetMode) {
@@ -195,30 +213,35 @@ void setToMode( int targetMode) {
     break;
   case MODE_EVENING:
     if (MODE_EVENING != mode) {
+      hw.crossfade(LUCKY7_TIMECROSSFADE);
       setEveningInit();
     }
     mode = MODE_EVENING;
     break;
   case MODE_NIGHT:
     if (MODE_NIGHT != mode) {
+      hw.crossfade(LUCKY7_TIMECROSSFADE);
       setNightInit();
     }
     mode = MODE_NIGHT;
     break;
   case MODE_PREDAWN:
     if (MODE_PREDAWN != mode) {
+      hw.crossfade(LUCKY7_TIMECROSSFADE);
       setPreDawnInit();
     }
     mode = MODE_PREDAWN;
     break;
   case MODE_MORNING:
     if (MODE_MORNING != mode) {
+      hw.crossfade(LUCKY7_TIMECROSSFADE);
       setMorningInit();
     }
     mode = MODE_MORNING;
     break;
   case MODE_DAY:
     if (MODE_DAY != mode) {
+      hw.crossfade(LUCKY7_TIMECROSSFADE);
       setDayInit();
     }
     mode = MODE_DAY;
@@ -226,26 +249,27 @@ void setToMode( int targetMode) {
   }
 }
 
-void statemap() {
-  const float batteryVoltage = hw.batteryVoltage();
+void statemap(const Lucky7::Frame & frame) {
+  const float batteryVoltage = frame.batteryVoltage;
   if ((mode != MODE_BATTERYLOW) &&
       ! overrideBatteryLow()    &&
       batteryVoltage <= getBatteryLowValue()) {
     setToMode(MODE_BATTERYLOW);
   }
 
-  const uint16_t lightLevel = hw.photocell2();
-  const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel);
+  const uint16_t lightLevel = frame.photocell2;
+  const TimeOfDay::DayPart dayPart = timeOfDay.updateAverage(lightLevel,
+                                                             frame.now);
 
   switch (mode) {
   case MODE_BATTERYLOW:
-    if (millis() > timeoutBatteryLow) {
+    if (frame.now > timeoutBatteryLow) {
       float batteryLowValue = getBatteryLowResetValue();
       if (inStartup) {
 	batteryLowValue = getBatteryLowValue();
       }
       if (batteryVoltage <= batteryLowValue) {
-        resetTimeoutBatteryLow();
+        resetTimeoutBatteryLow(frame.now);
       } else {
 	inStartup = false;
         setToMode(dayPart);
@@ -253,7 +277,7 @@ void statemap() {
     }
     break;
   case MODE_OVERRIDE:
-    if (millis() > timeoutOverride) {
+    if (frame.now > timeoutOverride) {
       setToMode(dayPart);
     }
     break;
@@ -263,16 +287,126 @@ void statemap() {
   }
 }
 
+void statemap() {
+  statemap(hw.captureFrame(millis()));
+}
+
+// Remote keys, as the key processKey() takes for them, which is the key
+// typed on Serial for the same thing.  The digits also pick the channel.
+// To add a remote, add its codes here.
+struct RemoteKey {
+  uint32_t code;
+  uint8_t  key;
+};
+
+static constexpr RemoteKey remoteKeys[] PROGMEM = {
+  {RC65X_KEY0,             '0'},
+  {RC65X_KEY1,             '1'},
+  {RC65X_KEY2,             '2'},
+  {RC65X_KEY3,             '3'},
+  {RC65X_KEY4,             '4'},
+  {RC65X_KEY5,             '5'},
+  {RC65X_KEY6,             '6'},
+  {RC65X_KEY7,             '7'},
+  {RC65X_KEY8,             '8'},
+  {RC65X_KEY9,             '9'},
+  {RC65X_KEYDOWN,          '0'}, // Control wheel down
+  {RC65X_KEYUP,            '^'}, // Control wheel up
+  {RC65X_KEYRED,           'B'},
+  {RC65X_KEYCHANUP,        'U'},
+  {RC65X_KEYCHANDOWN,      'D'},
+  {RC65X_KEYPLAY,          'P'},
+  {RC65X_KEYSELECT,        'P'},
+
+  {RM_YD065_KEY0,          '0'},
+  {RM_YD065_KEY1,          '1'},
+  {RM_YD065_KEY2,          '2'},
+  {RM_YD065_KEY3,          '3'},
+  {RM_YD065_KEY4,          '4'},
+  {RM_YD065_KEY5,          '5'},
+  {RM_YD065_KEY6,          '6'},
+  {RM_YD065_KEY7,          '7'},
+  {RM_YD065_KEY8,          '8'},
+  {RM_YD065_KEY9,          '9'},
+  {RM_YD065_KEYDOWN,       '0'},
+  {RM_YD065_KEYUP,         '^'},
+  {RM_YD065_KEYRED,        'B'},
+  {RM_YD065_KEYVOLUMEUP,   'U'},
+  {RM_YD065_KEYPROGUP,     'U'},
+  {RM_YD065_KEYVOLUMEDOWN, 'D'},
+  {RM_YD065_KEYPROGDOWN,   'D'},
+  {RM_YD065_KEYPLAY,       'P'},
+  {RM_YD065_KEYOK,         'P'},
+};
+#define REMOTEKEYS (sizeof(remoteKeys)/sizeof(remoteKeys[0]))
+
+// remoteKeys are found through a perfect hash of the code: the top
+// REMOTEKEYSLOTBITS of code*REMOTEKEYMULTIPLIER, which no two codes share.
+// If a new remote's codes do, the static_assert below fails, and another
+// odd multiplier that works has to be found.
+#define REMOTEKEYMULTIPLIER 0x5C975D85UL
+#define REMOTEKEYSLOTBITS   6
+
+constexpr uint8_t remoteKeyHash(const uint32_t code) {
+  return uint32_t(code * REMOTEKEYMULTIPLIER) >> (32 - REMOTEKEYSLOTBITS);
+}
+
+// Index of the remoteKeys entry from i on whose code hashes to slot,
+// 0xFF if none
+constexpr uint8_t remoteKeyFind(const uint8_t slot, const uint8_t i) {
+  return (i == REMOTEKEYS) ? 0xFF
+    : (remoteKeyHash(remoteKeys[i].code) == slot) ? i
+    : remoteKeyFind(slot, i + 1);
+}
+
+// Whether each remoteKeys entry from i on has its slot to itself
+constexpr bool remoteKeysPerfect(const uint8_t i) {
+  return (i == REMOTEKEYS) ||
+    (remoteKeyFind(remoteKeyHash(remoteKeys[i].code), 0) == i &&
+     remoteKeysPerfect(i + 1));
+}
+static_assert(remoteKeysPerfect(0),
+              "Remote key codes share a slot, change REMOTEKEYMULTIPLIER");
+
+// Which remoteKeys entry each slot holds, worked out at compile time
+#define REMOTEKEYSLOTS8(s)                                             \
+  remoteKeyFind((s)+0, 0), remoteKeyFind((s)+1, 0), remoteKeyFind((s)+2, 0), \
+  remoteKeyFind((s)+3, 0), remoteKeyFind((s)+4, 0), remoteKeyFind((s)+5, 0), \
+  remoteKeyFind((s)+6, 0), remoteKeyFind((s)+7, 0)
+static const uint8_t remoteKeySlots[1 << REMOTEKEYSLOTBITS] PROGMEM = {
+  REMOTEKEYSLOTS8( 0), REMOTEKEYSLOTS8( 8), REMOTEKEYSLOTS8(16),
+  REMOTEKEYSLOTS8(24), REMOTEKEYSLOTS8(32), REMOTEKEYSLOTS8(40),
+  REMOTEKEYSLOTS8(48), REMOTEKEYSLOTS8(56)
+};
+
+// The key for a remote's code, or code itself if it is not a remote key
+uint32_t remoteKey(const uint32_t code) {
+  const uint8_t i = pgm_read_byte(&remoteKeySlots[remoteKeyHash(code)]);
+  if (i != 0xFF && pgm_read_dword(&remoteKeys[i].code) == code) {
+    return pgm_read_byte(&remoteKeys[i].key);
+  }
+  return code;
+}
+
+#ifndef CUSTOM_PROCESSKEYHELD
+void processKeyHeld(const uint32_t /* irKey */) {
+  // Held keys are not used for most sketches' lights
+}
+#endif
+
 void input() {
   uint32_t irKey;
-  irKey = hw.loop();
+  irKey = hw.loop(); // Also reads this pass's hw.frame
 #ifdef DOING_UNIT_TESTING
   if (myIRKey != 0) {
     irKey = myIRKey;
   }
 #endif
   if (irKey) {
-    processKeyInit(irKey);
+    processKeyInit(remoteKey(irKey));
+  }
+  else if (hw.frame.irKeyEvent == Lucky7::KEY_HOLD) {
+    processKeyHeld(remoteKey(hw.frame.irKey));
   }
 
   if (Serial.available()) {
@@ -316,6 +450,17 @@ void processKeyInit(const uint32_t key) {
   }
 }
 
+void serialPrintCustomStatusModes(const int8_t lightModes[7]) {
+  // Use directly when the sketch's lights are not all Light objects,
+  // e.g. StaticDecayLight.  -1 for channels without a light.
+  uint8_t i;
+  for (i = 0; i < 7; i++) {
+    sprintf(sprintfBuffer,",%1i:[%2i,%3d]",
+            int(i+1),int(lightModes[i]), hw.output(i));
+    Serial.print(sprintfBuffer);
+  }
+}
+
 void serialPrintCustomStatusDefault(const Light * light1,
                                     const Light * light2,
                                     const Light * light3,
@@ -324,24 +469,21 @@ void serialPrintCustomStatusDefault(const Light * light1,
                                     const Light * light6,
                                     const Light * light7 ) {
   const Light * lights[7] = {light1,light2,light3,light4,light5,light6,light7};
-  const uint8_t values[7] = {hw.o1,hw.o2,hw.o3,hw.o4,hw.o5,hw.o6,hw.o7};
+  int8_t lightModes[7];
   uint8_t i;
-  int8_t  lightMode;
   for (i = 0; i < 7; i++) {
-    lightMode = -1;
+    lightModes[i] = -1;
     if (lights[i])
     {
-      lightMode = lights[i]->getLightMode();
+      lightModes[i] = lights[i]->getLightMode();
     }
-    sprintf(sprintfBuffer,",%1i:[%2i,%3d]",
-            int(i+1),int(lightMode), values[i]);
-    Serial.print(sprintfBuffer);
   }
+  serialPrintCustomStatusModes(lightModes);
 }
 
 
-void status(const bool override = false) {
-    const uint32_t time = millis();
+void status(const Lucky7::Frame & frame, const bool override = false) {
+    const uint32_t time = frame.now;
     if (override || (printContinuousStatus && time > timeoutStatus)) {
         timeoutStatus = time + TIMEOUTSTATUS;
         // Serial.print(F("\x1B[0;0f\x1B[K")); // home
@@ -350,7 +492,7 @@ void status(const bool override = false) {
         Serial.print(F("{\'t\':"));
         Serial.print(time);
         Serial.print(F(",\'p\':"));
-        Serial.print(hw.photocell2());
+        Serial.print(frame.photocell2);
         Serial.print(F(",\'pMx\':"));
         Serial.print(timeOfDay.getPhotocellAvgValueMax());
         Serial.print(F(",\'pMn\':"));
@@ -359,6 +501,8 @@ void status(const bool override = false) {
         Serial.print(timeOfDay.getPhotocellAvgValueCurrent());
         Serial.print(F(",\'lN\':"));
         Serial.print(timeOfDay.getLengthOfNight()/3600000);
+        Serial.print(F(",\'fN\':"));
+        Serial.print(timeOfDay.getNightForecast()/3600000);
         Serial.print(F(",\'m\':\'"));
         Serial.print((char)mode);
         Serial.print(F("\'"));
@@ -378,8 +522,13 @@ void status(const bool override = false) {
         Serial.print(F(",\'b\':"));
         Serial.print(blueLight.getLightMode());
 
+        Serial.print(F(",\'sU\':"));
+        Serial.print(Light::skippedUpdates);
+        Serial.print(F(",\'oW\':"));
+        Serial.print(hw.outputWrites);
+
         Serial.print(F(",\'v\':"));
-        Serial.print(hw.batteryVoltage(),2);
+        Serial.print(frame.batteryVoltage,2);
         Serial.print(F("}"));
 
         Serial.println();
@@ -391,6 +540,10 @@ void status(const bool override = false) {
     }
 }
 
+void status(const bool override = false) {
+  status(hw.captureFrame(millis()), override);
+}
+
 void setupStatusLights() {
   blueLight.setup(hw.o8 , ON, ON); // Setup status light blue
   redLight .setup(hw.o13, ON, ON); // and red
@@ -411,7 +564,11 @@ void setup() {
     serialPrintBanner();
     serialPrintHelp();
     hw.setup(); // Currently zeros out everything, and initializes some stuff.
-    timeOfDay.setup(500,500,10); // photocell value min, max and night/day threshhold %
+    // photocell value min, max, in ADC units times 2^extraBits, and
+    // night/day threshhold %.  Its timeouts start from hw.frame.now, 0
+    // until the first loop(), like the timeouts below.
+    timeOfDay.setup(500 << PhotocellFilter::extraBits,
+                    500 << PhotocellFilter::extraBits, 10, hw.frame.now);
 
     setupStatusLights();
     setupLightingAndMotorChannels();
@@ -433,14 +590,15 @@ void setup() {
 void loop() {
     input();        // 1) Call hw.loop() and ask Lucky7 hardware to set all
                     //    hardware output levels based on software output 
-                    //    levels (0-255)
+                    //    levels (0-255), and read the time, sensors and IR
+                    //    key for this pass into hw.frame
                     // 2) Read IR and serial port. If find something:
                     //    2a) Put in MODE_OVERRIDE if find something on either,
                     //        IR port or serial port, IR has precedence
                     //    2b) Call processKey to set correct MODE_* and
                     //        optionally set set output levels (On/OFF)
                     //        and/or (re)set timers.
-    statemap();     // 1) Read battery and put in MODE_BATTERYLOW if needed
+    statemap(hw.frame);// 1) Read battery and put in MODE_BATTERYLOW if needed
                     // 2) Get dayPart from TimeOfDay class.
                     //    Pass it the photocell level, which is used to figure
                     //    out what the time of day is
@@ -451,8 +609,9 @@ void loop() {
                     //        setToMode(dayPart)
                     // 4) If not MODE_BATTERYLOW or MODE_OVERRIDE, 
                     //    simply call setToMode(dayPart)
-    updateChannels();//Loop over the Light objects and call update on them,
+    updateChannels(hw.frame.now);
+                    // Loop over the Light objects and call update on them,
                     // but only do this every 10 millis, not every 1 millis
-    status();       // Print to serial port, reset board if running for 30 days.
+    status(hw.frame);// Print to serial port, reset board if running for 30 days.
 }
 #endif // AIRCRAFT_H
@@ -9,6 +9,8 @@
 IRrecv irRecv(IR);
 decode_results irResults;
 
+uint32_t Light::skippedUpdates = 0;
+
 Light::Light() : p_lightLevel(NULL), lightMode(LIGHT_MODE_NOTSET) {;}
 Light::~Light() {;}
 
@@ -63,65 +65,112 @@ BlinkingLight::BlinkingLight() {;}
 BlinkingLight::~BlinkingLight() {;}
 void BlinkingLight::setup(uint8_t & lightLevelVariable,
                           const uint8_t onLightLevelValue,
-                          const uint32_t onLengthValue,
-                          const uint32_t offLengthValue,
-                          const uint8_t maxLightLevelValue)
+                          const Interval * intervalValue)
 {
-  FlashingLight::setup(lightLevelVariable, onLightLevelValue, 1, onLengthValues,                        offLengthValues, maxLightLevelValues);
-  onLengthValues[0] = onLengthValue;
-  offLengthValues[0] = offLengthValue;
-  maxLightLevelValues[0] = maxLightLevelValue;
+  FlashingLight::setup(lightLevelVariable, onLightLevelValue, 1, intervalValue);
 }
 
+static const DecayLight::Interval fastBlinkInterval[1] PROGMEM = {
+  {LUCKY7_DURATION(FastBlinkingLight::onLengthValue),
+   LUCKY7_DURATION(FastBlinkingLight::offLengthValue), 0, ON}};
+
 FastBlinkingLight::FastBlinkingLight() {;}
 FastBlinkingLight::~FastBlinkingLight() {;}
 void FastBlinkingLight::setup(uint8_t  & lightLevelVariable,
-                              const uint8_t onLightLevelValue,
-                              const uint8_t maxLightLevelValue)
+                              const uint8_t onLightLevelValue)
 {
   BlinkingLight::setup(lightLevelVariable, // Where the light level will be stored
                        onLightLevelValue, // Brightness when light is constant on
-                       onLengthValue,
-                       offLengthValue,
-                       maxLightLevelValue);
+                       fastBlinkInterval);
 }
 
+static const DecayLight::Interval slowBlinkInterval[1] PROGMEM = {
+  {LUCKY7_DURATION(SlowBlinkingLight::onLengthValue),
+   LUCKY7_DURATION(SlowBlinkingLight::offLengthValue), 0, ON}};
+
 SlowBlinkingLight::SlowBlinkingLight() {;}
 SlowBlinkingLight::~SlowBlinkingLight() {;}
 void SlowBlinkingLight::setup(uint8_t  & lightLevelVariable,
-                              const uint8_t onLightLevelValue,
-                              const uint8_t maxLightLevelValue)
+                              const uint8_t onLightLevelValue)
 {
   BlinkingLight::setup(lightLevelVariable, // Where the light level will be stored
                        onLightLevelValue, // Brightness when light is constant on
-                       onLengthValue,
-                       offLengthValue,
-                       maxLightLevelValue);
+                       slowBlinkInterval);
 }
 
-FastSlowBlinkingLight::FastSlowBlinkingLight() : p_currentLight(NULL),blinkSpeed(NOTSET) {;}
+// On and off lengths of FastSlowBlinkingLight::FAST and SLOW blinks
+static const uint16_t fastSlowBlinkLengths[2][2] PROGMEM = {
+  {FastBlinkingLight::onLengthValue, FastBlinkingLight::offLengthValue},
+  {SlowBlinkingLight::onLengthValue, SlowBlinkingLight::offLengthValue}};
+
+FastSlowBlinkingLight::FastSlowBlinkingLight() :
+  changeTime(0), maxLightLevel(0), blinkSpeed(NOTSET), blinkOn(false) {;}
 FastSlowBlinkingLight::~FastSlowBlinkingLight() {;}
 void FastSlowBlinkingLight::setup(uint8_t & lightLevelVariable,
                                   const uint8_t onLightLevel,
                                   const uint8_t maxLightLevelValue)
 {
-  fastLight.setup(lightLevelVariable, onLightLevel, maxLightLevelValue);
-  slowLight.setup(lightLevelVariable, onLightLevel, maxLightLevelValue);
+  StaticLight::setup(lightLevelVariable, onLightLevel);
+  maxLightLevel = maxLightLevelValue;
+  lightMode     = Light::LIGHT_FLASHING;
+  changeTime    = 0;     // Change right away
+  blinkOn       = false; // Will cause us to go to on right away
+  blinkSpeed    = NOTSET;
   setToFast();
 }
 
+uint16_t FastSlowBlinkingLight::blinkLength(const uint8_t speed, const bool on)
+{
+  return pgm_read_word(&fastSlowBlinkLengths[speed == SLOW ? 1 : 0][on ? 0 : 1]);
+}
+
+void FastSlowBlinkingLight::setSpeed(const Speed speed)
+{
+  const uint16_t oldLength = blinkLength(blinkSpeed, blinkOn);
+  const uint16_t newLength = blinkLength(speed, blinkOn);
+  blinkSpeed = speed;
+
+  if (changeTime == 0) {
+    return; // Not blinking yet
+  }
+  // Move the end of the current on or off part, not its start
+  if (newLength >= oldLength) {
+    changeTime += newLength - oldLength;
+  } else if (changeTime > uint16_t(oldLength - newLength)) {
+    changeTime -= oldLength - newLength;
+  } else {
+    changeTime = 0;
+  }
+}
+
+void FastSlowBlinkingLight::update(const uint32_t now)
+{
+  if (now >= changeTime) {
+    blinkOn = !blinkOn;
+    if (blinkOn && Light::LIGHT_FLASHING == lightMode) {
+      *p_lightLevel = maxLightLevel;
+    }
+    const uint16_t length = blinkLength(blinkSpeed, blinkOn);
+    changeTime = changeTime + length;
+    // Check if time between calls to update() is > the on or off length
+    if (now >= changeTime) {
+      changeTime = now + length;
+    }
+  }
+
+  if (!blinkOn && Light::LIGHT_FLASHING == lightMode) {
+    *p_lightLevel = OFF;
+  }
+}
+
 DecayLight::DecayLight() :
   changeTime(0), decaying(false), decayStartTime(0), intervalIndex(0), 
-  numIntervals(0), 
-  onLength(NULL), decayLength(NULL), maxLightLevel(NULL), tau(NULL) {;}
+  numIntervals(0), intervals(NULL) {;}
 DecayLight::~DecayLight() {;}
 void DecayLight::setup(uint8_t  & lightLevelVariable,
                        const uint8_t onLightLevelValue,
                        const uint8_t numberOfValues,
-                       uint32_t * onLengthValues,
-                       uint32_t * decayLengthValues,
-                       uint8_t  * maxLightLevelValues,
-                       uint32_t * tauInMilliseconds)
+                       const Interval * intervalValues)
 {
   Light::setup(lightLevelVariable, onLightLevelValue);
 
@@ -130,10 +179,7 @@ void DecayLight::setup(uint8_t  & lightLevelVariable,
   *p_lightLevel = OFF; // Set the initial light level
   lightMode = LIGHT_FLASHING;
 
-  onLength = onLengthValues;
-  decayLength = decayLengthValues;
-  maxLightLevel = maxLightLevelValues;
-  tau = tauInMilliseconds;
+  intervals = intervalValues;
   numIntervals = numberOfValues;
 
   changeTime     = 0;    // Change right away
@@ -142,14 +188,24 @@ void DecayLight::setup(uint8_t  & lightLevelVariable,
   intervalIndex  = 0;   // Will be incremented during first call to update
 }
 
-void DecayLight::update()
+uint32_t DecayLight::duration(const uint16_t packedDuration)
+{
+  const uint32_t count = packedDuration & 0x3FFF;
+  switch (packedDuration >> 14) {
+  case 0:  return count;
+  case 1:  return count*10;
+  case 2:  return count*100;
+  default: return count*1000;
+  }
+}
+
+void DecayLight::update(const uint32_t now)
 {
   //Serial.println(F("In update() A"));
   uint8_t j;
 
   uint32_t changeTimeDelta = 0;
   
-  const uint32_t now = millis();
   j = intervalIndex % numIntervals;
   
   if (now >= changeTime) {
@@ -159,17 +215,17 @@ void DecayLight::update()
       intervalIndex++;
       j = intervalIndex % numIntervals;
       if (lightMode == LIGHT_FLASHING) {
-        *p_lightLevel = maxLightLevel[j];
+        *p_lightLevel = getMaxLightLevel(j);
       }
-      changeTimeDelta = onLength[j];
+      changeTimeDelta = getOnLength(j);
     } else {
       //Serial.println(F("In update() C"));
       decaying = true;
-      changeTimeDelta = decayLength[j];
+      changeTimeDelta = getDecayLength(j);
     }
     decayStartTime = changeTime;
     changeTime = changeTime + changeTimeDelta;
-    // Check if time between calls to update() is > onLength[j] or decayLength[j]
+    // Check if time between calls to update() is > onLength or decayLength
     if (now >= changeTime) { 
       //Serial.println(F("In update() D"));
       decayStartTime = now;
@@ -181,7 +237,8 @@ void DecayLight::update()
   //Serial.println(F("In update() E"));
   if (decaying && lightMode == LIGHT_FLASHING) {
     //std::cerr << "A" << std::endl;
-    if (tau == NULL || tau[j] == 0) {
+    const uint32_t tauValue = getTau(j);
+    if (tauValue == 0) {
       //std::cerr << "B" << std::endl;
       *p_lightLevel = OFF;
     } else {
@@ -191,8 +248,7 @@ void DecayLight::update()
       //std::cerr << "now " << int(now) << std::endl;
       //std::cerr << "time " << int(time) << std::endl;
       // T = dT*e(-t/tau)  // T = Dt @ t=0, T = 0 @ t = infinity
-      *p_lightLevel =
-        uint8_t(float(maxLightLevel[j])*exp(-float(time)/float(tau[j]))+.5);
+      *p_lightLevel = decayLevel(getMaxLightLevel(j), time, tauValue);
       //std::cerr << "lightLevel " << int(lightLevel) << std::endl;
     }
     //Serial.println(F("In update() G"));
@@ -206,10 +262,57 @@ void DecayLight::update()
   //           << " j = " << int(j) << std::endl
   //           << "decaying = " << decaying
   //           << " lightLevel = " << int(lightLevel)
-  //           << " tau  = " << (tau != NULL ? int(tau[j]) : 0)
+  //           << " tau  = " << int(getTau(j))
   //           << std::endl;
 }
 
+uint8_t DecayLight::decayLevelFloat(const uint8_t maxLevel,
+                                    const uint32_t time,
+                                    const uint32_t tauValue)
+{
+  return uint8_t(float(maxLevel)*exp(-float(time)/float(tauValue))+.5);
+}
+
+// exp(-n) in Q16 for n = 0..11.  exp(-12)*255 rounds to 0.
+#define DECAYEXPINTCNT 12
+static const uint16_t decayExpInt[DECAYEXPINTCNT] PROGMEM = {
+  65535, 24109, 8869, 3263, 1200, 442, 162, 60, 22, 8, 3, 1};
+
+// exp(-k/32) in Q16 for k = 0..32
+#define DECAYEXPFRACBITS 5
+static const uint16_t decayExpFrac[(1 << DECAYEXPFRACBITS) + 1] PROGMEM = {
+  65535, 63520, 61565, 59671, 57835, 56056, 54331, 52660, 51039,
+  49469, 47947, 46472, 45042, 43656, 42313, 41011, 39750, 38527,
+  37341, 36192, 35079, 34000, 32954, 31940, 30957, 30005, 29081,
+  28187, 27319, 26479, 25664, 24875, 24109};
+
+uint8_t DecayLight::decayLevelFixed(const uint8_t maxLevel,
+                                    uint32_t time,
+                                    uint32_t tauValue)
+{
+  // Keep time << 12 from overflowing.  Only matters for very long tau.
+  while (time > 0xFFFFFUL) {
+    time     >>= 1;
+    tauValue >>= 1;
+  }
+  if (tauValue == 0 || time >= DECAYEXPINTCNT*tauValue) {
+    return OFF;
+  }
+
+  // x = time/tau in Q12
+  const uint16_t x = uint16_t((time << 12)/tauValue);
+  const uint8_t  n = x >> 12;
+  const uint8_t  k = (x >> 7) & ((1 << DECAYEXPFRACBITS) - 1);
+  const uint8_t  r = x & 0x7F;
+
+  const uint16_t e0 = pgm_read_word(&decayExpFrac[k]);
+  const uint16_t e1 = pgm_read_word(&decayExpFrac[k+1]);
+  const uint16_t eFrac = e0 - uint16_t((uint32_t(e0 - e1)*r) >> 7);
+  const uint16_t e = (uint32_t(pgm_read_word(&decayExpInt[n]))*eFrac) >> 16;
+
+  return uint8_t((uint32_t(maxLevel)*e + 0x8000) >> 16);
+}
+
 RotatingLight::RotatingLight() :
   flatLength(0), 
   flatLightLevel(0), 
@@ -218,7 +321,8 @@ RotatingLight::RotatingLight() :
   maxLightLevel(0), 
   changeTime(0),
   pulsing(LIGHT_MODE_NOTSET),
-  pulseStartTime(0) {;}
+  pulseStartTime(0),
+  phaseStep(0) {;}
 
 RotatingLight::~RotatingLight() {;}
 void RotatingLight::setup(uint8_t & lightLevelVariable,    
@@ -241,6 +345,7 @@ void RotatingLight::setup(uint8_t & lightLevelVariable,
   pulseLength     = pulseLengthValue;
   minLightLevel   = minLightLevelValue;
   maxLightLevel   = maxLightLevelValue;
+  phaseStep       = pulsePhaseStep(pulseLengthValue);
 
   changeTime     = 0;    // Change right away
   pulsing        = true; // Will cause us to go to pulsing mode right away
@@ -248,12 +353,11 @@ void RotatingLight::setup(uint8_t & lightLevelVariable,
 }
 
 
-void RotatingLight::update()
+void RotatingLight::update(const uint32_t now)
 {
 
   uint32_t changeTimeDelta = 0;
   
-  const uint32_t now = millis();
   
   if (now >= changeTime) {
     if (pulsing) {
@@ -286,9 +390,13 @@ void RotatingLight::update()
       const uint32_t time = now - pulseStartTime;
       //std::cerr << "now " << int(now) << std::endl;
       //std::cerr << "time " << int(time) << std::endl;
-      // T = dT*e(-t/tau)  // T = Dt @ t=0, T = 0 @ t = infinity
+#ifdef LUCKY7_FLOAT_LIGHT_MATH
       *p_lightLevel =
-        uint8_t(float(maxLightLevel-minLightLevel)*fabs(sin(float(time)*3.1415926536/float(pulseLength)))) + minLightLevel;
+        pulseLevelFloat(minLightLevel, maxLightLevel, time, pulseLength);
+#else
+      *p_lightLevel =
+        pulseLevelFixed(minLightLevel, maxLightLevel, time, phaseStep);
+#endif
       //std::cerr << "lightLevel " << int(lightLevel) << std::endl;
     }
   }
@@ -304,32 +412,163 @@ void RotatingLight::update()
   //           << std::endl;
 }
 
+// sin(k*Pi/128) in Q16 for k = 0..64, a quarter of a sine wave
+#define PULSESINEBITS 6
+static const uint16_t pulseSine[(1 << PULSESINEBITS) + 1] PROGMEM = {
+  0, 1608, 3216, 4821, 6424, 8022, 9616, 11204, 12785,
+  14359, 15924, 17479, 19024, 20557, 22078, 23586, 25080, 26558,
+  28020, 29466, 30893, 32303, 33692, 35062, 36410, 37736, 39040,
+  40320, 41576, 42806, 44011, 45190, 46341, 47464, 48559, 49624,
+  50660, 51665, 52639, 53581, 54491, 55368, 56212, 57022, 57798,
+  58538, 59244, 59914, 60547, 61145, 61705, 62228, 62714, 63162,
+  63572, 63944, 64277, 64571, 64827, 65043, 65220, 65358, 65457,
+  65516, 65535};
+
+// Phase runs 0 to PULSEHALFPHASE over one pulse, i.e. 0 to Pi
+#define PULSEHALFPHASE 0x8000UL
+
+uint32_t RotatingLight::pulsePhaseStep(const uint32_t pulseLengthValue)
+{
+  if (pulseLengthValue == 0) {
+    return 0;
+  }
+  // Round up so the peak of the pulse lands on the peak of the table
+  return ((PULSEHALFPHASE << 16) + pulseLengthValue - 1)/pulseLengthValue;
+}
+
+uint8_t RotatingLight::pulseLevelFloat(const uint8_t minLevel,
+                                       const uint8_t maxLevel,
+                                       const uint32_t time,
+                                       const uint32_t pulseLengthValue)
+{
+  return uint8_t(float(maxLevel-minLevel)*fabs(sin(float(time)*3.1415926536/float(pulseLengthValue)))) + minLevel;
+}
+
+uint8_t RotatingLight::pulseLevelFixed(const uint8_t minLevel,
+                                       const uint8_t maxLevel,
+                                       const uint32_t time,
+                                       const uint32_t phaseStepValue)
+{
+  // |sin| repeats every Pi, so only the low 15 bits of the phase matter.
+  // This also makes it harmless if time*phaseStep wraps around.
+  uint16_t phase = uint16_t((time*phaseStepValue) >> 16) & (PULSEHALFPHASE - 1);
+  if (phase > (PULSEHALFPHASE >> 1)) {
+    phase = PULSEHALFPHASE - phase; // Second half of the pulse mirrors the first
+  }
+
+  const uint8_t  k = phase >> 8;
+  const uint8_t  r = phase & 0xFF;
+  const uint16_t s0 = pgm_read_word(&pulseSine[k]);
+  const uint16_t sine = (k < (1 << PULSESINEBITS))
+    ? s0 + uint16_t((uint32_t(pgm_read_word(&pulseSine[k+1]) - s0)*r) >> 8)
+    : s0;
+
+  return uint8_t((uint32_t(maxLevel-minLevel)*sine + 0xFF) >> 16) + minLevel;
+}
+
 FlashingLight::FlashingLight() {;}
 FlashingLight::~FlashingLight() {;}
 void FlashingLight::setup(uint8_t & lightLevelVariable,
                           const uint8_t onLightLevelValue,
                           const uint8_t numberOfValues,
-                          uint32_t * onLengthValues,
-                          uint32_t * offLengthValues,
-                          uint8_t  * maxLightLevelValues)
+                          const Interval * intervalValues)
 {
-  DecayLight::setup(lightLevelVariable, onLightLevelValue, numberOfValues, onLengthValues,
-                   offLengthValues, maxLightLevelValues, NULL);
+  DecayLight::setup(lightLevelVariable, onLightLevelValue, numberOfValues,
+                    intervalValues);
+}
+
+void SequenceLight::setup(uint8_t & lightLevelVariable,
+                          const uint8_t onLightLevelValue,
+                          const Key * trackValues,
+                          const uint8_t numberOfKeys)
+{
+  StaticLight::setup(lightLevelVariable, onLightLevelValue);
+  *p_lightLevel = OFF;
+  track         = trackValues;
+  numKeys       = numberOfKeys;
+  changeTime    = 0;
+  fromLevel     = OFF;
+  if (numberOfKeys == 0) {
+    // Nothing to play, so just an On/Off light
+    lightMode = Light::LIGHT_OFF;
+    keyIndex  = 0;
+    return;
+  }
+  lightMode     = Light::LIGHT_FLASHING;
+  keyIndex      = numberOfKeys - 1; // Will cause us to go to key 0 right away
+}
+
+void SequenceLight::update(const uint32_t now)
+{
+  if (numKeys == 0) {
+    return;
+  }
+  if (now >= changeTime) {
+    // Current key is over, start the next one from where it ended
+    fromLevel = keyLevel(keyIndex);
+    keyIndex  = (keyIndex + 1 < numKeys) ? keyIndex + 1 : 0;
+    const uint16_t length = keyLength(keyIndex);
+    changeTime = changeTime + length;
+    // Check if time between calls to update() is > the key's length
+    if (now >= changeTime) {
+      changeTime = now + length;
+    }
+  }
+
+  if (Light::LIGHT_FLASHING == lightMode) {
+    *p_lightLevel = levelAt(now - (changeTime - keyLength(keyIndex)));
+  }
+}
+
+uint8_t SequenceLight::levelAt(const uint32_t time) const
+{
+  const uint8_t  toLevel = keyLevel(keyIndex);
+  const uint16_t length  = keyLength(keyIndex);
+
+  if (time >= length) {
+    return toLevel;
+  }
+
+  switch (pgm_read_byte(&track[keyIndex].interpolation)) {
+  case LINEAR:
+    if (toLevel >= fromLevel) {
+      return fromLevel + uint8_t(uint32_t(toLevel - fromLevel)*time/length);
+    }
+    return fromLevel - uint8_t(uint32_t(fromLevel - toLevel)*time/length);
+  case DECAY: {
+    const uint32_t tauValue = length/SEQUENCE_DECAYTAUS;
+    if (tauValue == 0) {
+      return toLevel;
+    }
+    if (toLevel <= fromLevel) {
+      return toLevel + DecayLight::decayLevel(fromLevel - toLevel, time, tauValue);
+    }
+    return toLevel - DecayLight::decayLevel(toLevel - fromLevel, time, tauValue);
+  }
+  default:
+    return toLevel;
+  }
 }
 
 void TimeOfDay::setup(const uint16_t initialValueMin,
                       const uint16_t initialValueMax,
-                      const uint8_t nightDayThresholdPercentageValue )
+                      const uint8_t nightDayThresholdPercentageValue,
+                      const uint32_t now)
 {
-  uint32_t now = millis();
   update30secTimeout = now + LUCKY7_TIME30SEC;
   update5minTimeout  = now + LUCKY7_TIME5MIN;
   eveningLength      = LUCKY7_TIME4HOUR;
   predawnLength      = LUCKY7_TIME2HOUR;
   morningLength      = LUCKY7_TIME2HOUR;
-  photocellValuesIndex = 0;
+  photocellValuesSum   = 0;
+  photocellValuesMin   = 0xFFFF;
+  photocellValuesMax   = 0;
+  photocellValuesCount = 0;
 
   lengthOfNight = LUCKY7_TIME12HOUR;
+  nightForecast = LUCKY7_TIME12HOUR;
+  nightsIndex = 0;
+  nightsCount = 0;
   nightStart = 0;
   dayStart = 0;
   currentDayPart = DAY;
@@ -340,66 +579,58 @@ void TimeOfDay::setup(const uint16_t initialValueMin,
   photocellAvgValueMax = initialValueMax;
   photocellAvgValueCurrent = 0;
 
+  uint8_t i;
+  for (i = 0; i < PHOTOCELLDAYS; i++) {
+    photocellDays[i].min = initialValueMin;
+    photocellDays[i].max = initialValueMax;
+  }
+  photocellDaysIndex  = 0;
+  photocellDayUpdates = 0;
+
   updateAverageTestMode = false;
 }
 
 
-TimeOfDay::DayPart TimeOfDay::updateAverage(const uint16_t lightLevel)
+TimeOfDay::DayPart TimeOfDay::updateAverage(const uint16_t lightLevel,
+                                             const uint32_t now)
 {
   if (updateAverageTestMode) {
     return getDayPart();
   }
   
   // Take reading every 30 seconds and record
-  if (millis() >= update30secTimeout &&
-      photocellValuesIndex < PHOTOCELLVALUESSIZE) {
-    photocellValues[photocellValuesIndex] = lightLevel;
-    photocellValuesIndex++;
-    update30secTimeout = millis() + LUCKY7_TIME30SEC;
+  if (now >= update30secTimeout) {
+    photocellValuesSum += lightLevel;
+    if (lightLevel < photocellValuesMin) {
+      photocellValuesMin = lightLevel;
+    }
+    if (lightLevel > photocellValuesMax) {
+      photocellValuesMax = lightLevel;
+    }
+    photocellValuesCount++;
+    update30secTimeout = now + LUCKY7_TIME30SEC;
   }
-  
-  const uint8_t photocellValuesCount = photocellValuesIndex;
 
   // At five minutes
-  if (millis() >= update5minTimeout) {
-#ifdef DOING_UNIT_TESTING
-    // Can easily happen during testing.  If you hit this, look into setting
-    // the updateAverageTestMode flag via setUpdateAverageTestMode(true);
-    assert(photocellValuesCount > 2);
-#endif
-    // Throw out high and low
-    uint8_t minIndex = 0;
-    uint8_t maxIndex = 0;
-    uint16_t min = photocellValues[0];
-    uint16_t max = photocellValues[0];
-    uint8_t i;    
-    for (i = 1; i < photocellValuesCount; i++) {
-      if (photocellValues[i] < min) {
-        min = photocellValues[i];
-        minIndex = i;
-      }
-      if (photocellValues[i] > max) {
-        max = photocellValues[i];
-        maxIndex = i;
-      }
+  if (now >= update5minTimeout) {
+    // Average, throwing out high and low when there are enough readings
+    // to.  With no readings the average and time of day are left alone.
+    if (photocellValuesCount > 2) {
+      const uint32_t sum = photocellValuesSum
+        - photocellValuesMin - photocellValuesMax;
+      updatePhotocellAvgValues(sum/(photocellValuesCount - 2));
+      updateTimeOfDay(now);
     }
-    uint32_t sum = 0;
-    uint8_t  numValues = 0;
-    for (i = 0; i < photocellValuesCount; i++)
-    {
-      if (i != minIndex && i != maxIndex) {
-        sum = sum + photocellValues[i];
-        numValues++;
-      }
+    else if (photocellValuesCount > 0) {
+      updatePhotocellAvgValues(photocellValuesSum/photocellValuesCount);
+      updateTimeOfDay(now);
     }
-    // Average
-    // NOTE: If photocellValuesCount < 3 numValues could be 0
-    const uint16_t avg = (uint16_t)(sum/numValues);
-    updatePhotocellAvgValues(avg);
-    updateTimeOfDay();
-    // Reset index and counter
-    photocellValuesIndex = 0;
-    update5minTimeout = millis() + LUCKY7_TIME5MIN;
+    // Start over
+    photocellValuesSum   = 0;
+    photocellValuesMin   = 0xFFFF;
+    photocellValuesMax   = 0;
+    photocellValuesCount = 0;
+    update5minTimeout = now + LUCKY7_TIME5MIN;
   }
 
   return getDayPart();
@@ -408,7 +639,15 @@ TimeOfDay::DayPart TimeOfDay::updateAverage(const uint16_t lightLevel)
 void TimeOfDay::updatePhotocellAvgValues(uint16_t photocellAvgValue)
 {
   photocellAvgValueCurrent = photocellAvgValue;
-  
+
+  PhotocellDay & today = photocellDays[photocellDaysIndex];
+  if (photocellAvgValue > today.max) {
+    today.max = photocellAvgValue;
+  }
+  if (photocellAvgValue < today.min) {
+    today.min = photocellAvgValue;
+  }
+
   if (photocellAvgValue > photocellAvgValueMax) {
     photocellAvgValueMax = photocellAvgValue;
   }
@@ -416,44 +655,117 @@ void TimeOfDay::updatePhotocellAvgValues(uint16_t photocellAvgValue)
   if (photocellAvgValue < photocellAvgValueMin) {
     photocellAvgValueMin = photocellAvgValue;
   }
+
+  // After a day's worth of averages the oldest day is dropped, and min and
+  // max are taken again from the days that are left.  A new day starts
+  // out with this average, so no day is ever empty.
+  photocellDayUpdates++;
+  if (photocellDayUpdates >= PHOTOCELLDAYUPDATES) {
+    photocellDayUpdates = 0;
+    photocellDaysIndex  = (photocellDaysIndex + 1 < PHOTOCELLDAYS)
+      ? photocellDaysIndex + 1 : 0;
+    photocellDays[photocellDaysIndex].min = photocellAvgValue;
+    photocellDays[photocellDaysIndex].max = photocellAvgValue;
+
+    photocellAvgValueMin = photocellAvgValue;
+    photocellAvgValueMax = photocellAvgValue;
+    uint8_t i;
+    for (i = 0; i < PHOTOCELLDAYS; i++) {
+      if (photocellDays[i].min < photocellAvgValueMin) {
+        photocellAvgValueMin = photocellDays[i].min;
+      }
+      if (photocellDays[i].max > photocellAvgValueMax) {
+        photocellAvgValueMax = photocellDays[i].max;
+      }
+    }
+  }
 }
 
-void TimeOfDay::updateTimeOfDay()
+void TimeOfDay::updateTimeOfDay(const uint32_t now)
 {
   const uint16_t nightDayThreshold = getNightDayThreshold();
 
   switch (currentDayPart) {
   case EVENING:
-    if (millis() > nightStart + eveningLength) {
+    if (now > nightStart + eveningLength) {
       currentDayPart = NIGHT;
     }
     break;
   case NIGHT:
-    if (millis() > nightStart + lengthOfNight - predawnLength) {
+    if (now > nightStart + nightForecast - predawnLength) {
       currentDayPart = PREDAWN;
     }
     // Yes, there is no break here.
   case PREDAWN:
     if (photocellAvgValueCurrent > nightDayThreshold) {
-      dayStart = millis();
+      dayStart = now;
       lengthOfNight = dayStart - nightStart;
+      learnNight(lengthOfNight);
       currentDayPart = MORNING;
     }
     break;
   case MORNING:
-    if (millis() > dayStart + morningLength) {
+    if (now > dayStart + morningLength) {
       currentDayPart = DAY;
     }
     break;
   case DAY:
     if (photocellAvgValueCurrent < nightDayThreshold) {
-      nightStart = millis();
+      nightStart = now;
       currentDayPart = EVENING;
     }
     break;
   }    
 }
 
+void TimeOfDay::learnNight(const uint32_t length)
+{
+  // Too short or long to be a night, say a storm at noon or a start in
+  // the dark
+  if (length < LUCKY7_NIGHTMIN || length > LUCKY7_NIGHTMAX) {
+    return;
+  }
+  nights[nightsIndex] = length/LUCKY7_TIME1MIN;
+  nightsIndex = (nightsIndex + 1 < NIGHTSSIZE) ? nightsIndex + 1 : 0;
+  if (nightsCount < NIGHTSSIZE) {
+    nightsCount++;
+  }
+
+  // Fit a straight line through the nights, oldest first, and take it one
+  // night further, so the forecast follows the seasons.  Night i is c/2
+  // nights from the middle one.  The line is kept no steeper than the
+  // seasons go, so one cloudy dusk or dawn is not followed all the way.
+  int32_t sum   = 0;
+  int32_t sumC  = 0; // Sum of c*night
+  int32_t sumC2 = 0; // Sum of c*c
+  uint8_t i;
+  for (i = 0; i < nightsCount; i++) {
+    const int8_t  c     = 2*i - (nightsCount - 1);
+    const uint8_t index =
+      (nightsIndex + NIGHTSSIZE - nightsCount + i) % NIGHTSSIZE;
+    sum   += nights[index];
+    sumC  += c*int32_t(nights[index]);
+    sumC2 += c*c;
+  }
+  int32_t forecast = sum/nightsCount;
+  if (nightsCount > 1) {
+    const int32_t trend = sumC*(nightsCount + 1)/sumC2;
+    const int32_t trendMax = LUCKY7_NIGHTCHANGEMAX*(nightsCount + 1)/2;
+    forecast += (trend > trendMax) ? trendMax
+      : (trend < -trendMax) ? -trendMax : trend;
+  }
+
+  nightForecast = uint32_t(forecast)*LUCKY7_TIME1MIN;
+  if (nightForecast < LUCKY7_NIGHTMIN) {
+    nightForecast = LUCKY7_NIGHTMIN;
+  }
+  if (nightForecast > LUCKY7_NIGHTMAX) {
+    nightForecast = LUCKY7_NIGHTMAX;
+  }
+  eveningLength = nightForecast/100*LUCKY7_EVENINGPERCENT;
+  predawnLength = nightForecast/100*LUCKY7_PREDAWNPERCENT;
+}
+
 uint16_t TimeOfDay::getNightDayThreshold()
 {
   const float percentage = nightDayThresholdPercentage/100.0;
@@ -483,19 +795,19 @@ void UpDownMotor::setup(uint8_t & oUp, uint8_t & oDown)
   motorDownStartTime = 0;
 }
 
-void UpDownMotor::motorUpStart() {
+void UpDownMotor::motorUpStart(const uint32_t now) {
     //Serial.print(F("In UpDownMotor::motorUpStart() \n"));
     motorDownStop();
     if (!inMotorUpMode) {
-      motorUpStartTime = millis();
+      motorUpStartTime = now;
     }
     inMotorUpMode = true;
 }
-void UpDownMotor::motorDownStart() {
+void UpDownMotor::motorDownStart(const uint32_t now) {
     //Serial.print(F("In UpDownMotor::motorDownStart() \n"));
     motorUpStop();
     if (!inMotorDownMode) {
-      motorDownStartTime = millis();
+      motorDownStartTime = now;
     }
     inMotorDownMode = true;
 }
@@ -510,7 +822,7 @@ void UpDownMotor::motorDownStop() {
     inMotorDownMode = false;
 }
 
-void UpDownMotor::motorUpdate() {
+void UpDownMotor::motorUpdate(const uint32_t now) {
     if ((inMotorUpMode && inMotorDownMode) || (*p_outputUp && *p_outputDown) )
     {
       Serial.println(F("ERROR: In UpDownMotor::motorUpdate() found ((inMotorUpMode && inMotorDownMode) || (*p_outputUp && *p_outputDown))"));
@@ -520,218 +832,600 @@ void UpDownMotor::motorUpdate() {
       return;
     }
 
-    motorUpUpdate();
-    motorDownUpdate();
+    motorUpUpdate(now);
+    motorDownUpdate(now);
 }
 
-void UpDownMotor::motorUpUpdate() {
+void UpDownMotor::motorUpUpdate(const uint32_t now) {
     if (! inMotorUpMode) {
       return;
     }
 
-    if (millis() > motorUpStartTime + LUCKY7_TIMEMOTORDELAY) {
+    if (now > motorUpStartTime + LUCKY7_TIMEMOTORDELAY) {
       *p_outputUp = ON;
     }
       
-    if (millis() > motorUpStartTime + LUCKY7_TIMEOUTMOTORUPDOWN) {
+    if (now > motorUpStartTime + LUCKY7_TIMEOUTMOTORUPDOWN) {
       motorUpStop();
     }
 }
 
-void UpDownMotor::motorDownUpdate() {
+void UpDownMotor::motorDownUpdate(const uint32_t now) {
     if (! inMotorDownMode) {
       return;
     }
 
-    if (millis() > motorDownStartTime + LUCKY7_TIMEMOTORDELAY) {
+    if (now > motorDownStartTime + LUCKY7_TIMEMOTORDELAY) {
       *p_outputDown = ON;
     }
       
-    if (millis() > motorDownStartTime + LUCKY7_TIMEOUTMOTORUPDOWN) {
+    if (now > motorDownStartTime + LUCKY7_TIMEOUTMOTORUPDOWN) {
         motorDownStop();
     }
 }
 
+// Pin and dimmable flag of each output channel
+static const uint8_t outputChannelPins[LUCKY7_NUMOUTPUTS] PROGMEM = {
+  O1, O2, O3, O4, O5, O6, O7, O8, O13};
+#define OUTPUTS_DIMMABLE 0x077 // o1..o3, o5..o7 are PWM
+
+uint8_t Lucky7::outputPin(const uint8_t channel)
+{
+  return pgm_read_byte(&outputChannelPins[channel]);
+}
+
+uint8_t & Lucky7::output(const uint8_t channel)
+{
+  switch (channel) {
+  case 0:  return o1;
+  case 1:  return o2;
+  case 2:  return o3;
+  case 3:  return o4;
+  case 4:  return o5;
+  case 5:  return o6;
+  case 6:  return o7;
+  case 7:  return o8;
+  default: return o13;
+  }
+}
+
+bool Lucky7::outputDimmable(const uint8_t channel)
+{
+  return OUTPUTS_DIMMABLE & (1 << channel);
+}
+
 void Lucky7::setup() {
-  o1 = 0;
-  o2 = 0;
-  o3 = 0;
-  o4 = 0;
-  o5 = 0;
-  o6 = 0;
-  o7 = 0;
-  o8 = 0;
-  o13 = 0;
-
-  pinMode(O1,OUTPUT);
-  pinMode(O2,OUTPUT);
-  pinMode(O3,OUTPUT);
-  pinMode(O4,OUTPUT);
-  pinMode(O5,OUTPUT);
-  pinMode(O6,OUTPUT);
-  pinMode(O7,OUTPUT);
-  pinMode(O8,OUTPUT);
-  pinMode(O13,OUTPUT);
+  allOutputsOff();
+
+  uint8_t i;
+  for (i = 0; i < 7; i++) {
+    oCurve [i] = CURVE_LINEAR;
+    oDither[i] = 0;
+    oShown [i] = 0;
+  }
+  for (i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    oWritten[i] = 0;
+    pinMode(outputPin(i),OUTPUT);
+  }
+  oDirty           = 0x1FF; // Write every pin on the first loop()
+  outputWrites     = 0;
+  rampActive       = 0;
+  loopTime         = 0;
+  crossfadeLength  = 0;
+  crossfadePending = false;
+  crossfadeOutputs = 0x7F;
 
   saveOutputState();
 
-  irTimeout = 0;
+  irHeldKey   = 0;
+  irPressTime = 0;
+  irLastTime  = 0;
 
   pinMode(A4,INPUT);
   pinMode(A5,INPUT);
-  aveptr = 0;
 
-  uint8_t i;
-  for (i = 0; i < AVECNT; i++) {
-    pc1[i] = 0;
-    pc2[i] = 0;
-    bc [i] = 0;
+  pc1.reset(0);
+  pc2.reset(0);
+  bc .reset(0);
+  for (i = 0; i < LUCKY7_NUMSENSORS; i++) {
+    sampleTime[i] = 0;
   }
+  sampleInterval[LUCKY7_SENSORPHOTOCELL1] = LUCKY7_PHOTOCELLSAMPLETIME;
+  sampleInterval[LUCKY7_SENSORPHOTOCELL2] = LUCKY7_PHOTOCELLSAMPLETIME;
+  sampleInterval[LUCKY7_SENSORBATTERY]    = LUCKY7_BATTERYSAMPLETIME;
+  samplesPrimed = 0;
+  frame = captureFrame(0);
 
   irRecv.enableIRIn(); // Start the receiver
 }
 
 void Lucky7::saveOutputState()
 {
-  o1Saved = o1;
-  o2Saved = o2; 
-  o3Saved = o3; 
-  o4Saved = o4; 
-  o5Saved = o5; 
-  o6Saved = o6; 
-  o7Saved = o7; 
+  uint8_t i;
+  for (i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    oSaved[i] = output(i);
+  }
 }
 
 void Lucky7::setOutputStateFromSaved()
 {
-   o1 = o1Saved;
-   o2 = o2Saved; 
-   o3 = o3Saved; 
-   o4 = o4Saved; 
-   o5 = o5Saved; 
-   o6 = o6Saved; 
-   o7 = o7Saved; 
+  uint8_t i;
+  for (i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    output(i) = oSaved[i];
+  }
+}
+
+void Lucky7::allOutputsOff()
+{
+  uint8_t i;
+  for (i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    output(i) = OFF;
+  }
 }
 
 
 uint32_t Lucky7::loop() {
-  uint8_t i = (aveptr++) % AVECNT;
   uint32_t rv = 0;
 
-  analogWrite(O1,o1);
-  analogWrite(O2,o2);
-  analogWrite(O3,o3);
-  digitalWrite(O4,o4);
-  analogWrite(O5,o5);
-  analogWrite(O6,o6);
-  analogWrite(O7,o7);
-  digitalWrite(O8,o8);
-  digitalWrite(O13,o13);
-
-  pc1[i] = analogRead(A4);
-  pc2[i] = analogRead(A5);
-  bc[i]  = analogRead(A0);
-
-  // std::cout << "analogRead(A4) pc1[" << int(i) << "] =" << pc1[i] << std::endl;
-  // std::cout << "analogRead(A5) pc2[" << int(i) << "] =" << pc2[i] << std::endl;
-  // std::cout << "analogRead(A0)  bc[" << int(i) << "] =" << bc[i] << std::endl;
-  
-  rv = irLoop();
+  const uint32_t now = millis();
+  rampOutputs(now);
+
+  const uint16_t fade = crossfadeFraction(now);
+
+  uint8_t value[LUCKY7_NUMOUTPUTS];
+  uint8_t channel;
+  for (channel = 0; channel < LUCKY7_NUMOUTPUTS; channel++) {
+    value[channel] = outputDimmable(channel)
+      ? shownLevel(channel+1,output(channel),fade)
+      : (output(channel) ? HIGH : LOW);
+  }
+  commitOutputs(value);
+
+  sampleSensors(now);
+  frame = captureFrame(now);
+
+  const KeyEvent key = irLoop(now);
+  frame.irKey      = key.key;
+  frame.irKeyEvent = key.type;
+  if (key.type == KEY_PRESS) {
+    rv = key.key;
+  }
   return rv;
 }
 
-uint32_t Lucky7::irLoop() {
-  uint32_t rv = 0;
-  
-  const uint32_t currentMillis = millis();
-  if (currentMillis > irTimeout) { // Only look at ir remote value every irTimeout seconds
-    if (irRecv.decode(&irResults)) {
-      rv = irResults.value;
-      irTimeout = currentMillis + 500; // irTimeout = .5 seconds
+Lucky7::Frame Lucky7::captureFrame(const uint32_t now) {
+  Frame f;
+  f.now            = now;
+  f.irKey          = 0;
+  f.irKeyEvent     = KEY_NONE;
+  f.photocell1     = photocell1();
+  f.photocell2     = photocell2();
+  f.batteryVoltage = batteryVoltage();
+  return f;
+}
+
+// ADC sampler, shared with the ADC interrupt.  Sensors waiting for a
+// conversion are flagged in adcPending.  The interrupt stores each result in
+// adcValue[], flags it in adcReady, and starts the next pending sensor, so
+// the ADC works through them while loop() gets on with other things.
+// Conversions are started only when a sample is due, rather than with the
+// ADC free-running, which would take an interrupt every 104 us and delay
+// the IR receiver's edge timing.  The interrupt is turned off again once
+// the sensors are done, so an analogRead() between batches is not taken as
+// a sensor's value.  Sketches convert other pins through the sampler too,
+// in slot LUCKY7_ADCUSER, with Lucky7::adcRead().
+#define LUCKY7_ADCUSER LUCKY7_NUMSENSORS // Slot of Lucky7::adcRead()'s pin
+static const uint8_t sensorPins[LUCKY7_NUMSENSORS] PROGMEM = {A4, A5, A0};
+static volatile uint16_t adcValue[LUCKY7_NUMSENSORS + 1];
+static volatile uint8_t  adcPending = 0;
+static volatile uint8_t  adcReady   = 0;
+static volatile bool     adcBusy    = false;
+static volatile uint8_t  adcSensor  = 0; // Sensor being converted
+static volatile uint8_t  adcUserPin = 0; // Pin in slot LUCKY7_ADCUSER
+
+static uint8_t adcPin(const uint8_t sensor)
+{
+  return (sensor == LUCKY7_ADCUSER) ? adcUserPin
+    : pgm_read_byte(&sensorPins[sensor]);
+}
+
+#if defined(__AVR_ATmega328P__) && !defined(DOING_UNIT_TESTING)
+#define ADC_LOCK()   const uint8_t oldSREG = SREG; cli()
+#define ADC_UNLOCK() SREG = oldSREG
+
+// Start a conversion of the first pending sensor.  Interrupts must be off.
+static void adcStartNext()
+{
+  uint8_t sensor;
+  for (sensor = 0; sensor <= LUCKY7_ADCUSER; sensor++) {
+    if (adcPending & (1 << sensor)) {
+      adcPending &= ~(1 << sensor);
+      adcSensor = sensor;
+      adcBusy   = true;
+      // AVcc reference, as analogRead() uses.  The prescaler is left as
+      // the Arduino core set it.
+      const uint8_t pin = adcPin(sensor);
+      ADMUX   = _BV(REFS0) | ((pin >= A0) ? pin - A0 : pin);
+      ADCSRA |= _BV(ADIE) | _BV(ADSC);
+      return;
     }
-  } else {
-    irRecv.resume();
   }
-  
-  return rv;
+  ADCSRA &= ~_BV(ADIE); // Leave analogRead()'s conversions alone
+  adcBusy = false;
 }
 
-uint16_t Lucky7::photocell(uint16_t * pc) {
-  uint16_t sum = 0;
-  uint8_t i;
-  for (i = 0; i < AVECNT; i++) {
-    //std::cout << "pc[" << int(i) << "] =" << pc[i] << std::endl;
-    sum += pc[i];
+ISR(ADC_vect)
+{
+  adcValue[adcSensor] = ADC;
+  adcReady |= 1 << adcSensor;
+  adcStartNext();
+}
+#else
+#define ADC_LOCK()
+#define ADC_UNLOCK()
+
+// No ADC interrupt here, so convert the pending sensors right away
+static void adcStartNext()
+{
+  uint8_t sensor;
+  for (sensor = 0; sensor <= LUCKY7_ADCUSER; sensor++) {
+    if (adcPending & (1 << sensor)) {
+      adcPending &= ~(1 << sensor);
+      adcValue[sensor] = analogRead(adcPin(sensor));
+      adcReady |= 1 << sensor;
+    }
   }
-  return (uint16_t)(sum/AVECNT);
+  adcBusy = false;
 }
+#endif
 
-uint16_t Lucky7::photocell1() {
-  return photocell(pc1);
+bool Lucky7::adcRead(const uint8_t pin, uint16_t & value)
+{
+  const uint8_t bit = 1 << LUCKY7_ADCUSER;
+  bool ready = false;
+  ADC_LOCK();
+  if (adcReady & bit) {
+    adcReady &= ~bit;
+    // A result for a pin asked for before is dropped, and pin asked for
+    if (adcUserPin == pin) {
+      value = adcValue[LUCKY7_ADCUSER];
+      ready = true;
+    }
+  }
+  if (!ready && !(adcPending & bit) &&
+      !(adcBusy && adcSensor == LUCKY7_ADCUSER)) {
+    adcUserPin  = pin;
+    adcPending |= bit;
+    if (!adcBusy) {
+      adcStartNext();
+    }
+  }
+  ADC_UNLOCK();
+  return ready;
 }
 
-uint16_t Lucky7::photocell2() {
-  return photocell(pc2);
+void Lucky7::sampleSensors(const uint32_t now)
+{
+  uint8_t due = 0;
+  uint8_t sensor;
+  for (sensor = 0; sensor < LUCKY7_NUMSENSORS; sensor++) {
+    if (int32_t(now - sampleTime[sensor]) >= 0) {
+      due |= 1 << sensor;
+      sampleTime[sensor] = now + sampleInterval[sensor];
+    }
+  }
+
+  uint16_t value[LUCKY7_NUMSENSORS];
+  uint8_t ready;
+  {
+    ADC_LOCK();
+    adcPending |= due;
+    if (!adcBusy && adcPending) {
+      adcStartNext();
+    }
+    ready = adcReady;
+    adcReady &= 1 << LUCKY7_ADCUSER; // Left for adcRead()
+    for (sensor = 0; sensor < LUCKY7_NUMSENSORS; sensor++) {
+      value[sensor] = adcValue[sensor];
+    }
+    ADC_UNLOCK();
+  }
+
+  for (sensor = 0; sensor < LUCKY7_NUMSENSORS; sensor++) {
+    const uint8_t bit = 1 << sensor;
+    if (!(ready & bit)) {
+      continue;
+    }
+    // The first sample resets the filter, so the averages start from it
+    // rather than from 0
+    const bool first = !(samplesPrimed & bit);
+    samplesPrimed |= bit;
+    switch (sensor) {
+    case LUCKY7_SENSORPHOTOCELL1:
+      first ? pc1.reset(value[sensor]) : pc1.add(value[sensor]);
+      break;
+    case LUCKY7_SENSORPHOTOCELL2:
+      first ? pc2.reset(value[sensor]) : pc2.add(value[sensor]);
+      break;
+    default:
+      first ? bc .reset(value[sensor]) : bc .add(value[sensor]);
+      break;
+    }
+  }
 }
 
-float Lucky7::batteryVoltage() {
-  uint32_t sum = 0;
+// Where the on/off outputs O4, O8 and O13 are in the ATmega328's ports
+#define O4_PORTD_BIT  (1 << 7)
+#define O8_PORTB_BIT  (1 << 0)
+#define O13_PORTB_BIT (1 << 5)
+
+void Lucky7::commitOutputs(const uint8_t * value)
+{
+  uint16_t changed = oDirty;
   uint8_t i;
-  for (i = 0; i < AVECNT; i++) {
-    //std::cout << "bc[" << int(i) << "] =" << bc[i] << std::endl;
-    sum += bc[i];
+  for (i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    if (value[i] != oWritten[i]) {
+      changed |= 1 << i;
+    }
+    oWritten[i] = value[i];
+  }
+  oDirty = 0;
+  if (changed == 0) {
+    return;
+  }
+
+  for (i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    if (outputDimmable(i) && (changed & (1 << i))) {
+      analogWrite(outputPin(i), value[i]);
+      outputWrites++;
+    }
   }
-  return (float)(sum/AVECNT)*BVSCALE;
+
+  if ((changed & ~OUTPUTS_DIMMABLE) == 0) {
+    return;
+  }
+#if defined(__AVR_ATmega328P__) && !defined(DOING_UNIT_TESTING)
+  // Set all three with two port writes, rather than three digitalWrite()s
+  // that each look up the pin's port and bit
+  const uint8_t oldSREG = SREG;
+  cli();
+  PORTD = value[3] ? (PORTD | O4_PORTD_BIT) : (PORTD & ~O4_PORTD_BIT);
+  PORTB = (PORTB & ~(O8_PORTB_BIT | O13_PORTB_BIT))
+    | (value[7] ? O8_PORTB_BIT  : 0)
+    | (value[8] ? O13_PORTB_BIT : 0);
+  SREG = oldSREG;
+  outputWrites++;
+#else
+  for (i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    if (!outputDimmable(i) && (changed & (1 << i))) {
+      digitalWrite(outputPin(i), value[i]);
+      outputWrites++;
+    }
+  }
+#endif
 }
 
-void Lucky7::o1MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O1, o1, targetValue, stepDelay);
+void Lucky7::crossfade(const uint16_t length)
+{
+  uint8_t i;
+  for (i = 0; i < 7; i++) {
+    crossfadeFrom[i] = oShown[i];
+  }
+  crossfadeLength  = length;
+  crossfadePending = true;
 }
-void Lucky7::o2MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O2, o2, targetValue, stepDelay);
+
+uint16_t Lucky7::crossfadeFraction(const uint32_t now)
+{
+  if (crossfadeLength == 0) {
+    return 0x100;
+  }
+
+  if (crossfadePending) {
+    crossfadePending = false;
+    crossfadeStart   = now;
+  }
+  const uint32_t time = now - crossfadeStart;
+  if (time >= crossfadeLength) {
+    crossfadeLength = 0;
+    return 0x100;
+  }
+  return (time << 8)/crossfadeLength;
 }
-void Lucky7::o3MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O3, o3, targetValue, stepDelay);
+
+uint8_t Lucky7::shownLevel(const uint8_t output, const uint8_t level,
+                           const uint16_t fade)
+{
+  uint8_t shown = level;
+  if (fade < 0x100 && (crossfadeOutputs & (1 << (output-1)))) {
+    const uint8_t from = crossfadeFrom[output-1];
+    shown = (level >= from)
+      ? from + uint8_t((uint16_t(level - from)*fade) >> 8)
+      : from - uint8_t((uint16_t(from - level)*fade) >> 8);
+  }
+  oShown[output-1] = shown;
+  return outputLevel(output, shown);
 }
-void Lucky7::o4MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O4, o4, targetValue, stepDelay);
+
+// 4080*(4k/255)^gamma for k = 0..64, PWM levels in 1/16ths
+#define OUTPUTCURVEBITS 6
+static const uint16_t outputCurveLED[(1 << OUTPUTCURVEBITS) + 1] PROGMEM = {
+  0, 0, 2, 5, 9, 15, 23, 32, 42, 55, 69, 85, 104, 123, 145, 169, 195,
+  223, 253, 284, 318, 355, 393, 433, 476, 520, 567, 616, 668, 721, 777,
+  835, 896, 958, 1023, 1091, 1161, 1233, 1307, 1384, 1463, 1545, 1629,
+  1716, 1805, 1896, 1990, 2087, 2185, 2287, 2391, 2497, 2606, 2718, 2832,
+  2949, 3068, 3190, 3314, 3441, 3571, 3703, 3838, 3975, 4115};
+static const uint16_t outputCurveBulb[(1 << OUTPUTCURVEBITS) + 1] PROGMEM = {
+  0, 5, 16, 31, 49, 69, 93, 119, 147, 178, 211, 245, 282, 320, 361, 403,
+  447, 492, 539, 588, 638, 690, 744, 798, 855, 912, 972, 1032, 1094, 1157,
+  1221, 1287, 1354, 1423, 1492, 1563, 1635, 1708, 1783, 1859, 1935, 2013,
+  2093, 2173, 2254, 2337, 2420, 2505, 2591, 2678, 2766, 2855, 2945, 3036,
+  3128, 3222, 3316, 3411, 3507, 3605, 3703, 3802, 3902, 4003, 4106};
+
+void Lucky7::setOutputCurve(const uint8_t output, const OutputCurve curve)
+{
+  oCurve [output-1] = curve;
+  oDither[output-1] = 0;
 }
-void Lucky7::o5MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O5, o5, targetValue, stepDelay);
+
+void Lucky7::setCrossfade(const uint8_t output, const bool fade)
+{
+  if (fade) {
+    crossfadeOutputs |= 1 << (output-1);
+  }
+  else {
+    crossfadeOutputs &= ~(1 << (output-1));
+  }
 }
-void Lucky7::o6MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O6, o6, targetValue, stepDelay);
+
+uint16_t Lucky7::outputCurveValue(const uint8_t curve, const uint8_t level)
+{
+  if (CURVE_LINEAR == curve) {
+    return uint16_t(level) << 4;
+  }
+
+  const uint16_t * table = (CURVE_LED == curve) ? outputCurveLED : outputCurveBulb;
+  const uint8_t  k  = level >> 2;
+  const uint8_t  r  = level & 0x3;
+  const uint16_t e0 = pgm_read_word(&table[k]);
+  return e0 + ((pgm_read_word(&table[k+1]) - e0)*r >> 2);
 }
-void Lucky7::o7MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O7, o7, targetValue, stepDelay);
+
+uint8_t Lucky7::outputLevel(const uint8_t output, const uint8_t level)
+{
+  const uint8_t curve = oCurve[output-1];
+  if (CURVE_LINEAR == curve) {
+    return level;
+  }
+
+  // Curve values never exceed 4080, so there is room to round up
+  const uint16_t value = outputCurveValue(curve, level);
+  uint8_t pwm = value >> 4;
+  uint8_t & dither = oDither[output-1];
+  dither += value & 0xF;
+  if (dither >= 16) {
+    dither -= 16;
+    pwm++;
+  }
+  return pwm;
 }
-void Lucky7::o8MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O8, o8, targetValue, stepDelay);
+
+// Takes the next code from the IR receiver, if there is one, and works out
+// whether it is a new key or the one being held.  The receiver queues the
+// codes, so none are lost while loop() is busy, and each is timed from
+// when it was received rather than when it is taken.
+Lucky7::KeyEvent Lucky7::irLoop(const uint32_t now) {
+  if (!irRecv.decode(&irResults)) {
+    const KeyEvent rv = {0, 0, KEY_NONE};
+    return rv;
+  }
+#ifndef IR_STREAMING
+  // The receiver stops at the end of each code until resume().  With
+  // IR_STREAMING it queues codes and never stops, so there is no need.
+  irRecv.resume();
+#endif
+
+#ifdef DOING_UNIT_TESTING
+  // arduino-mock's decode_results has no time, see Lucky7Test.IRCodeTime
+  const uint32_t codeTime = now;
+#else
+  const uint32_t codeTime = irCodeTime(now, micros(), irResults.time);
+#endif
+  return irKeyEvent(irResults.value, codeTime);
 }
-void Lucky7::o13MoveTo(uint8_t targetValue, const uint16_t stepDelay) {
-  outputMoveTo(O13, o13, targetValue, stepDelay);
+
+// What code, received at time, does to the key being held
+Lucky7::KeyEvent Lucky7::irKeyEvent(const uint32_t code, const uint32_t time) {
+  KeyEvent rv = {0, 0, KEY_NONE};
+
+  if (irHeldKey && time - irLastTime <= LUCKY7_IRREPEATTIME &&
+      (code == LUCKY7_IRREPEAT || code == irHeldKey)) {
+    rv.type = (time - irPressTime >= LUCKY7_IRHOLDTIME) ? KEY_HOLD : KEY_REPEAT;
+  }
+  else if (code == LUCKY7_IRREPEAT) {
+    // Repeat of a key whose code was missed
+    irHeldKey = 0;
+    return rv;
+  }
+  else {
+    rv.type = KEY_PRESS;
+    irHeldKey   = code;
+    irPressTime = time;
+  }
+  irLastTime = time;
+  rv.key  = irHeldKey;
+  rv.time = irPressTime;
+  return rv;
 }
 
-void Lucky7::outputMoveTo(const uint8_t outputPin, uint8_t & currentValue, uint8_t targetValue, const uint16_t stepDelay) {
-  int16_t i;
-  
-  if (targetValue == currentValue) {
+// Photocell levels keep PhotocellFilter's extra bits, and TimeOfDay works
+// in the same units
+uint16_t Lucky7::photocell1() {
+  return pc1.value();
+}
+
+uint16_t Lucky7::photocell2() {
+  return pc2.value();
+}
+
+float Lucky7::batteryVoltage() {
+  return bc.value()*(BVSCALE/(1 << BatteryFilter::extraBits));
+}
+
+void Lucky7::outputMoveTo(const uint8_t channel, const uint8_t targetValue,
+                          const uint16_t stepDelay) {
+  const uint16_t bit = (1 << channel);
+
+  if (stepDelay == 0 || output(channel) == targetValue) {
+    output(channel) = targetValue;
+    rampActive &= ~bit;
     return;
   }
-  
-  if (targetValue > currentValue) {
-    for (i = currentValue; i <= targetValue; i++) {
-      //Serial.println(i);
-      analogWrite(outputPin,i);
-      delayMicroseconds(stepDelay);
+
+  rampTarget   [channel] = targetValue;
+  rampStepDelay[channel] = stepDelay;
+  rampCarry    [channel] = 0;
+  // Time since the last loop() is not part of the ramp
+  if (!rampActive) {
+    loopTime = millis();
+  }
+  rampActive |= bit;
+}
+
+void Lucky7::rampOutputs(const uint32_t now) {
+  uint32_t elapsed = now - loopTime;
+  loopTime = now;
+
+  if (!rampActive) {
+    return;
+  }
+
+  if (elapsed > LUCKY7_RAMPMAXELAPSED) {
+    elapsed = LUCKY7_RAMPMAXELAPSED;
+  }
+
+  uint8_t channel;
+  for (channel = 0; channel < LUCKY7_NUMOUTPUTS; channel++) {
+    const uint16_t bit = (1 << channel);
+    if (!(rampActive & bit)) {
+      continue;
     }
-  } else { // (currentValue > targetValue)
-    for (i = currentValue; i >= targetValue; i--) {
-      //Serial.println(i);
-      analogWrite(outputPin,i);
-      delayMicroseconds(stepDelay);
+
+    const uint32_t time  = rampCarry[channel] + elapsed*1000;
+    const uint32_t steps = time/rampStepDelay[channel];
+    rampCarry[channel]   = time % rampStepDelay[channel];
+
+    uint8_t & value = output(channel);
+    const uint8_t target = rampTarget[channel];
+    const uint8_t distance = (target > value) ? target - value : value - target;
+    if (steps >= distance) {
+      value = target;
+      rampActive &= ~bit;
+    } else if (target > value) {
+      value += steps;
+    } else {
+      value -= steps;
     }
   }
-  currentValue = targetValue;
 }
 
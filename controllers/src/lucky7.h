@@ -5,12 +5,30 @@
  #define FRIEND_TEST(a, b)
 #else
  #include "Serial.h"
+ // Lookup tables live in flash on the Arduino, in regular memory when testing
+ #ifndef PROGMEM
+  #define PROGMEM
+ #endif
+ #ifndef pgm_read_byte
+  #define pgm_read_byte(address) (*(const uint8_t *)(address))
+ #endif
+ #ifndef pgm_read_word
+  #define pgm_read_word(address) (*(const uint16_t *)(address))
+ #endif
+ #ifndef pgm_read_dword
+  #define pgm_read_dword(address) (*(const uint32_t *)(address))
+ #endif
 #endif
 
+// Light curves are computed with integer lookup tables by default.  Define
+// LUCKY7_FLOAT_LIGHT_MATH to compute them with float and libm instead.
+// #define LUCKY7_FLOAT_LIGHT_MATH
+
 #define OFF 0
 #define ON  255
 
-// PWM outputs
+// PWM outputs.  O2 and O3 are on timer 1, which IRrecv leaves alone as it
+// times the IR pin's edges with micros().
 #define O1  11
 #define O2  10
 #define O3  9
@@ -22,10 +40,19 @@
 #define O8  8
 #define O13 13
 
+// Output channels, Lucky7::output(0..8): o1..o7, o8, o13
+#define LUCKY7_NUMOUTPUTS 9
+
 #define IR  2
 
 #define AVECNT 10
 
+// Sensors read by the ADC, see Lucky7::setSampleInterval()
+#define LUCKY7_SENSORPHOTOCELL1 0 // A4
+#define LUCKY7_SENSORPHOTOCELL2 1 // A5
+#define LUCKY7_SENSORBATTERY    2 // A0
+#define LUCKY7_NUMSENSORS       3
+
 // ((5/1024)/10000)*43000 ideal
 // 12.16/553
 #define BVSCALE 0.02198915009
@@ -35,9 +62,25 @@
 #define LUCKY7_TIMEMOTORDELAY         2000  // 2 sec
 #define LUCKY7_TIME30SEC             30000  // 30 sec
 #define LUCKY7_TIME5MIN             300000  // 300 sec = 5 min
+#define LUCKY7_TIME1MIN              60000  // 1 min
 #define LUCKY7_TIME2HOUR           7200000U // 2 hours
 #define LUCKY7_TIME4HOUR          14400000U // 4 hours
 #define LUCKY7_TIME12HOUR         43200000U // 12 hours
+#define LUCKY7_TIME24HOUR         86400000U // 24 hours
+#define LUCKY7_NIGHTMIN           14400000U // 4 hours, shorter nights are not learned
+#define LUCKY7_NIGHTMAX           72000000U // 20 hours, nor longer
+#define LUCKY7_NIGHTCHANGEMAX            5  // minutes a night, the most the seasons change it
+#define LUCKY7_EVENINGPERCENT           33  // of the night to come
+#define LUCKY7_PREDAWNPERCENT           17  // of the night to come
+#define LUCKY7_TIMECROSSFADE          2000  // 2 sec
+#define LUCKY7_RAMPMAXELAPSED        60000  // 1 min
+#define LUCKY7_PHOTOCELLEXTRABITS        2  // Oversampled, see PhotocellFilter
+#define LUCKY7_PHOTOCELLSAMPLETIME     200  // .2 sec, 16 = 4^EXTRABITS per 3.2 sec,
+                                            // AVECNT of those = 32 sec
+#define LUCKY7_BATTERYSAMPLETIME      1000  // 1 sec
+#define LUCKY7_IRREPEATTIME            250  // .25 sec between codes of a held key
+#define LUCKY7_IRHOLDTIME              500  // .5 sec before a held key is KEY_HOLD
+#define LUCKY7_IRREPEAT        0xFFFFFFFFUL // REPEAT from IRremote, a held NEC key
 
 class Lucky7;
 
@@ -50,9 +93,16 @@ class Lucky7;
 // class BlinkingLight     : public FlashingLight
 // class FastBlinkingLight : public BlinkingLight
 // class SlowBlinkingLight : public BlinkingLight
-// class FastSlowBlinkingLight
-//   FastBlinkingLight fastLight;
-//   SlowBlinkingLight slowLight;
+
+// Light classes with no virtual functions
+// class StaticLight
+// class FastSlowBlinkingLight              : public StaticLight
+// template <...> class StaticDecayLight    : public StaticLight
+// template <...> class StaticRotatingLight : public StaticLight
+// class SequenceLight                      : public StaticLight
+
+// Several lights in one object
+// template <...> class LightBank
 
 class Light
 {
@@ -94,6 +144,13 @@ public:
   void incrementOnLightLevel(const int16_t onLightLevelIncrement);
   
   void update() {;};
+  void update(const uint32_t) {;};
+  // Time at which update() can next change the light level.  On/Off lights
+  // only change in on() and off(), so never.
+  uint32_t getNextUpdateTime() const {return 0xFFFFFFFF;};
+
+  // Number of update()s updateIfDue() found there was no need for
+  static uint32_t skippedUpdates;
 
   Light::MODE getLightMode() const {return lightMode;};
   
@@ -110,6 +167,10 @@ class RotatingLight: public Light
 {
   // In this class the light level rises and then decays based on a sign wave such that
   // light level = (maxLightLevel-minLightLevel)*abs(sin(time*(Pi/pulseLength))) + minLightLevel
+  //
+  // Unless LUCKY7_FLOAT_LIGHT_MATH is defined, sin() is not called.  The
+  // pulse is tracked as a 16-bit phase, 0 to 32768 over pulseLength, found
+  // from time*phaseStep, and looked up in a quarter-wave sine table.
 
 
 private:
@@ -129,6 +190,7 @@ protected:
   uint32_t changeTime;     // Keep track of when its time to change modes
   bool     pulsing;        // Flag if in pulse or non-pulse mode
   uint32_t pulseStartTime; // Keep track of when pulse started.
+  uint32_t phaseStep;      // Phase advance per millisecond, see pulsePhaseStep()
 
 public:
   RotatingLight();
@@ -143,10 +205,59 @@ public:
              const uint8_t  maxLightLevelValue);
   
   void flash() { on(); *p_lightLevel = minLightLevel; lightMode = LIGHT_FLASHING;}
-  void update();
+  void update() {update(millis());};
+  void update(const uint32_t now);
   bool getPulsing() {return pulsing;};
+  // Every update() moves a pulse, otherwise nothing happens until changeTime
+  uint32_t getNextUpdateTime() const {
+    return (pulsing && lightMode == LIGHT_FLASHING) ? 0 : changeTime;
+  };
+
+  // Phase advance per millisecond, in 1/65536ths, for a half sine wave
+  // pulseLength milliseconds long
+  static uint32_t pulsePhaseStep(const uint32_t pulseLengthValue);
+  // Light level time milliseconds into a pulse
+  static uint8_t pulseLevelFloat(const uint8_t minLevel, const uint8_t maxLevel,
+                                 const uint32_t time,
+                                 const uint32_t pulseLengthValue);
+  static uint8_t pulseLevelFixed(const uint8_t minLevel, const uint8_t maxLevel,
+                                 const uint32_t time,
+                                 const uint32_t phaseStepValue);
+};
+
+
+// A duration packed into 16 bits for the flash-resident timing tables:
+// the top 2 bits select milliseconds, 1/100ths, 1/10ths or whole seconds
+// and the other 14 bits count them.  ms must be a multiple of the unit
+// picked, which is the finest one that fits, so 110 and 1110 ms are held
+// exactly, 60000 ms as 6000 1/100ths and 300000 ms as 3000 1/10ths.
+// LUCKY7_DURATION() only takes constants, and fails to compile if ms is
+// over 16383 s or is not a whole number of its unit.
+constexpr uint32_t lucky7DurationUnit(const uint32_t ms)
+{
+  return ms < 0x4000UL     ? 1   :
+         ms < 0x4000UL*10  ? 10  :
+         ms < 0x4000UL*100 ? 100 : 1000;
+}
+
+constexpr uint16_t lucky7Duration(const uint32_t ms)
+{
+  return uint16_t((lucky7DurationUnit(ms) == 1   ? 0x0000 :
+                   lucky7DurationUnit(ms) == 10  ? 0x4000 :
+                   lucky7DurationUnit(ms) == 100 ? 0x8000 : 0xC000)
+                  | (ms/lucky7DurationUnit(ms)));
+}
+
+template <uint32_t ms>
+struct Lucky7Duration
+{
+  static_assert(ms < 0x4000UL*1000, "LUCKY7_DURATION() must be under 16384 s");
+  static_assert(ms % lucky7DurationUnit(ms) == 0,
+                "LUCKY7_DURATION() must be a whole number of its unit");
+  static constexpr uint16_t value = lucky7Duration(ms);
 };
 
+#define LUCKY7_DURATION(ms) (Lucky7Duration<(ms)>::value)
 
 class DecayLight: public Light
 {
@@ -185,13 +296,34 @@ class DecayLight: public Light
   // For us T_env = 0 and dT = maxLightLevel so
   // light_level = maxLightLevel*exp(-millis()/(tau))
   // where tau is given in seconds.
+  //
+  // Unless LUCKY7_FLOAT_LIGHT_MATH is defined, exp() is not called.  Instead
+  // exp(-t/tau) is looked up in two Q16 tables, one for the whole part of
+  // t/tau and one, linearly interpolated, for the fractional part.  The
+  // result is within +/-1 light level of the float calculation.
 
 private:
   FRIEND_TEST(DecayLight, Constructor);
   FRIEND_TEST(DecayLight, Update);
   FRIEND_TEST(DecayLight, Update2);
-  FRIEND_TEST(DecayLight, UpdateWithTauNULL);
+  FRIEND_TEST(DecayLight, UpdateWithTauZero);
   FRIEND_TEST(DecayLight, UpdateCalledInfrequently);
+  FRIEND_TEST(DecayLight, Intervals);
+
+public:
+  // One interval of a timing table kept in flash.  Lengths are packed
+  // with LUCKY7_DURATION().  A sketch
+  // declares, for example,
+  //   const DecayLight::Interval positionIntervals[1] PROGMEM = {
+  //     {LUCKY7_DURATION(110), LUCKY7_DURATION(1110), LUCKY7_DURATION(175), ON}};
+  struct Interval {
+    uint16_t onLength;      // Time to stay on before switching to decay mode
+    uint16_t decayLength;   // Time to stay in decay mode
+    uint16_t tau;           // Time constant, 0 to just switch off
+    uint8_t  maxLightLevel; // Light level when on
+  };
+
+  static uint32_t duration(const uint16_t packedDuration);
 
 protected:
   uint32_t changeTime;      // Keep track of when its time to change modes
@@ -200,14 +332,20 @@ protected:
   uint8_t  intervalIndex;   // Keep track of which lighting inverval we are on
   uint8_t  numIntervals;    // Length of onLenth, decayLength & maxLightLevels.
 
-  uint32_t * onLength;      // Time to stay on before switching to decay mode,
-                            // for each interval
-  uint32_t * decayLength;   // Time to stay in decay mode, before starting next
-                            // interval, for each interval
-  uint8_t  * maxLightLevel; // Light level when on, for each interval
-  uint32_t * tau;           // Time constants.  See discussion above
-
+  const Interval * intervals; // In PROGMEM, numIntervals long
 
+  uint32_t getOnLength(const uint8_t j) const {
+    return duration(pgm_read_word(&intervals[j].onLength));
+  };
+  uint32_t getDecayLength(const uint8_t j) const {
+    return duration(pgm_read_word(&intervals[j].decayLength));
+  };
+  uint8_t getMaxLightLevel(const uint8_t j) const {
+    return pgm_read_byte(&intervals[j].maxLightLevel);
+  };
+  uint32_t getTau(const uint8_t j) const {
+    return duration(pgm_read_word(&intervals[j].tau));
+  };
   
 public:
   DecayLight();
@@ -216,20 +354,42 @@ public:
   void setup(uint8_t & lightLevelVariable,
              const uint8_t onLightLevel,
              const uint8_t numberOfValues,
-             uint32_t * onLengthValues,
-             uint32_t * decayLengthValues,
-             uint8_t  * maxLightLevelValues,
-             uint32_t * tauInMilliseconds);
+             const Interval * intervalValues);
+  // Switch to another table of the same length, for example one with a
+  // lower maxLightLevel for night, without restarting the light's timing
+  void setIntervals(const Interval * intervalValues) {intervals = intervalValues;};
   
-  void flash() { on(); *p_lightLevel = maxLightLevel[intervalIndex]; lightMode = LIGHT_FLASHING;}
-  void update();
+  void flash() { on(); *p_lightLevel = getMaxLightLevel(intervalIndex % numIntervals); lightMode = LIGHT_FLASHING;}
+  void update() {update(millis());};
+  void update(const uint32_t now);
   bool getDecaying() {return decaying;};
+  // Every update() moves a decay until it reaches OFF, after which the
+  // light stays OFF until changeTime
+  uint32_t getNextUpdateTime() const {
+    return (decaying && lightMode == LIGHT_FLASHING && *p_lightLevel != OFF)
+      ? 0 : changeTime;
+  };
+
+  // Light level time milliseconds after a decay from maxLevel started
+  static uint8_t decayLevel(const uint8_t maxLevel, const uint32_t time,
+                            const uint32_t tauValue)
+  {
+#ifdef LUCKY7_FLOAT_LIGHT_MATH
+    return decayLevelFloat(maxLevel, time, tauValue);
+#else
+    return decayLevelFixed(maxLevel, time, tauValue);
+#endif
+  };
+  static uint8_t decayLevelFloat(const uint8_t maxLevel, const uint32_t time,
+                                 const uint32_t tauValue);
+  static uint8_t decayLevelFixed(const uint8_t maxLevel, uint32_t time,
+                                 uint32_t tauValue);
 };
 
 class FlashingLight : public DecayLight
 {
   // Just like DecayLight but simply on and off, no decay.
-  // This one takes arrays of onLength, offLength and maxLightLevels
+  // This one takes a table of Intervals whose tau is 0
 
 private:
   FRIEND_TEST(FlashingLight, Constructor);
@@ -241,39 +401,26 @@ public:
   void setup(uint8_t & lightLevelVariable,
              const uint8_t onLightLevel,
              const uint8_t numberOfValues,
-             uint32_t * onLengthValues,
-             uint32_t * offLengthValues,
-             uint8_t  * maxLightLevelValues);
+             const Interval * intervalValues);
 };
 
 class BlinkingLight : public FlashingLight
 {
   // Just like DecayLight but simply on and off with no decay
-  // and one on and one off value are given.
+  // and one on and one off value are given, as a one Interval table.
 
 private:
   FRIEND_TEST(BlinkingLight, Constructor);
   FRIEND_TEST(BlinkingLight, Update);
   FRIEND_TEST(FastBlinkingLight, Constructor);
   FRIEND_TEST(SlowBlinkingLight, Constructor);
-  FRIEND_TEST(FastSlowBlinkingLight, Constructor);
-  FRIEND_TEST(FastSlowBlinkingLight, SetToFast);
-  FRIEND_TEST(FastSlowBlinkingLight, SetToSlow);
-  FRIEND_TEST(FastSlowBlinkingLight, FunctionCallOperatorGetValue);
-  FRIEND_TEST(B29Test, UpdateLights);
 
-  uint32_t onLengthValues[1];
-  uint32_t offLengthValues[1];
-  uint8_t  maxLightLevelValues[1];
-  
 public:
   BlinkingLight();
   virtual ~BlinkingLight();
   void setup(uint8_t & lightLevelVariable,
              const uint8_t onLightLevel,
-             const uint32_t onLengthValue,
-             const uint32_t offLengthValue,
-             const uint8_t  maxLightLevelValue);
+             const Interval * intervalValue);
 };
 
 class FastBlinkingLight : public BlinkingLight
@@ -287,9 +434,9 @@ public:                                        // 4 Hz
 public:
   FastBlinkingLight();
   virtual ~FastBlinkingLight();
+  // Blinks at full ON, from a one Interval table in flash
   void setup(uint8_t & lightLevelVariable,
-             const uint8_t onLightLevel,
-             const uint8_t maxLightLevelValue);
+             const uint8_t onLightLevel);
 };
 
 class SlowBlinkingLight : public BlinkingLight
@@ -303,14 +450,65 @@ public:
 public:
   SlowBlinkingLight();
   virtual ~SlowBlinkingLight();
+  // Blinks at full ON, from a one Interval table in flash
   void setup(uint8_t & lightLevelVariable,
-             const uint8_t onLightLevel,
-             const uint8_t maxLightLevelValue);
+             const uint8_t onLightLevel);
 };
 
-class FastSlowBlinkingLight
+class StaticLight
 {
-  // A fast or slow blinking light, use can choose.
+  // Same as Light, but with no vtable.  Base of the compile-time light
+  // classes below, which take their timing as template parameters instead
+  // of from a table, so update() inlines into a sketch's updateAll().
+  // A sketch opts in by declaring, for example,
+  //   StaticDecayLight<110, 1110, ON, 175> position;
+  // in place of a DecayLight and its one-interval table.
+
+private:
+  // Do not implement to make sure are never called
+  StaticLight(StaticLight & other);
+  StaticLight & operator=(const StaticLight &rhs);
+
+protected:
+  uint8_t * p_lightLevel;
+  uint8_t   onLightLevel; // Value when light simply On, not decaying or pulsing
+  int8_t    lightMode;    // Light::MODE, kept in one byte
+
+public:
+  StaticLight() : p_lightLevel(NULL), onLightLevel(0),
+                  lightMode(Light::LIGHT_MODE_NOTSET) {;};
+
+  void setup(uint8_t & lightLevelVariable, const uint8_t onLightLevelValue) {
+    p_lightLevel = &lightLevelVariable;
+    onLightLevel = onLightLevelValue;
+    off();
+  };
+
+  void update() {;};
+  void update(const uint32_t) {;};
+  uint32_t getNextUpdateTime() const {return 0xFFFFFFFF;};
+
+  Light::MODE getLightMode() const {return Light::MODE(lightMode);};
+
+  void on()  {*p_lightLevel = onLightLevel; lightMode = Light::LIGHT_ON;};
+  void off() {*p_lightLevel = OFF; lightMode = Light::LIGHT_OFF;};
+  void toggle() {
+    if (Light::LIGHT_OFF == lightMode) {
+      on();
+    } else if (Light::LIGHT_ON == lightMode) {
+      off();
+    }
+  };
+
+  uint8_t & operator()(void) {return *p_lightLevel;};
+};
+
+class FastSlowBlinkingLight : public StaticLight
+{
+  // A fast or slow blinking light, use can choose.  One light rather than a
+  // FastBlinkingLight and a SlowBlinkingLight, with the on and off lengths
+  // for each speed read from a table in flash.  Changing speed keeps when
+  // the current on or off part of the blink started.
   
 public:
   enum Speed {
@@ -323,16 +521,17 @@ private:
   FRIEND_TEST(FastSlowBlinkingLight, FunctionCallOperatorGetValue);
   FRIEND_TEST(FastSlowBlinkingLight, SetToFast);
   FRIEND_TEST(FastSlowBlinkingLight, SetToSlow);
-  FRIEND_TEST(B29Test, UpdateLights);
-  
-  // Do not implement to make sure are never called
-  FastSlowBlinkingLight(Light & other); 
-  FastSlowBlinkingLight & operator=(const Light &rhs);
-  
-  FastBlinkingLight fastLight;
-  SlowBlinkingLight slowLight;
-  BlinkingLight * p_currentLight;
-  Speed blinkSpeed;
+  FRIEND_TEST(FastSlowBlinkingLight, KeepsPhase);
+
+protected:
+  uint32_t changeTime;    // Keep track of when its time to change on/off
+  uint8_t  maxLightLevel; // Light level when blinking on
+  uint8_t  blinkSpeed;    // Speed, kept in one byte
+  bool     blinkOn;       // Flag if in on or off part of the blink
+
+  // Length of the on or off part of the blink at speed
+  static uint16_t blinkLength(const uint8_t speed, const bool on);
+  void setSpeed(const Speed speed);
   
 public:
   FastSlowBlinkingLight();
@@ -341,20 +540,469 @@ public:
              const uint8_t onLightLevel,
              const uint8_t maxLightLevelValue);
   
-  void setToFast() {p_currentLight = &fastLight; blinkSpeed = FAST;};
-  void setToSlow() {p_currentLight = &slowLight; blinkSpeed = SLOW;};
-  
-  Light::MODE getLightMode() {return p_currentLight->getLightMode();};
-  Speed getSpeed() {return blinkSpeed;};
-  void on() {fastLight.on(); slowLight.on();};
-  void off() {fastLight.off(); slowLight.off();};
-  void flash() {fastLight.flash(); slowLight.flash();};
-  void update() {p_currentLight->update();};
-  
-  uint8_t & operator()(void) {return (*p_currentLight)();};
-  
-  //  Light & operator=(const uint8_t value) {lightLevel = value; return *this;};
+  void setToFast() {setSpeed(FAST);};
+  void setToSlow() {setSpeed(SLOW);};
   
+  Speed getSpeed() const {return Speed(blinkSpeed);};
+  bool getBlinkOn() const {return blinkOn;};
+  void flash() {on(); *p_lightLevel = maxLightLevel; lightMode = Light::LIGHT_FLASHING;};
+  // See DecayLight::getNextUpdateTime()
+  uint32_t getNextUpdateTime() const {
+    return (!blinkOn && Light::LIGHT_FLASHING == lightMode && *p_lightLevel != OFF)
+      ? 0 : changeTime;
+  };
+
+  void update() {update(millis());};
+  void update(const uint32_t now);
+};
+
+template <uint32_t ON_LENGTH, uint32_t DECAY_LENGTH, uint8_t MAX_LEVEL,
+          uint32_t TAU>
+class StaticDecayLight : public StaticLight
+{
+  // DecayLight with a single interval known at compile time.  TAU of 0
+  // gives a light that just flashes on and off, like FlashingLight.
+
+protected:
+  uint32_t changeTime;     // Keep track of when its time to change modes
+  uint32_t decayStartTime; // Keep track of when decay started.
+  bool     decaying;       // Flag if in on or decay mode
+
+public:
+  StaticDecayLight() : changeTime(0), decayStartTime(0), decaying(false) {;};
+
+  void setup(uint8_t & lightLevelVariable, const uint8_t onLightLevelValue) {
+    StaticLight::setup(lightLevelVariable, onLightLevelValue);
+    *p_lightLevel  = OFF;
+    lightMode      = Light::LIGHT_FLASHING;
+    changeTime     = 0;    // Change right away
+    decayStartTime = 0;
+    decaying       = true; // Will cause us to go to on mode right away
+  };
+
+  void flash() {on(); *p_lightLevel = MAX_LEVEL; lightMode = Light::LIGHT_FLASHING;};
+  bool getDecaying() const {return decaying;};
+  // See DecayLight::getNextUpdateTime()
+  uint32_t getNextUpdateTime() const {
+    return (decaying && Light::LIGHT_FLASHING == lightMode && *p_lightLevel != OFF)
+      ? 0 : changeTime;
+  };
+
+  void update() {update(millis());};
+  void update(const uint32_t now) {
+    if (now >= changeTime) {
+      uint32_t changeTimeDelta;
+      if (decaying) {
+        decaying = false;
+        if (Light::LIGHT_FLASHING == lightMode) {
+          *p_lightLevel = MAX_LEVEL;
+        }
+        changeTimeDelta = ON_LENGTH;
+      } else {
+        decaying = true;
+        changeTimeDelta = DECAY_LENGTH;
+      }
+      decayStartTime = changeTime;
+      changeTime = changeTime + changeTimeDelta;
+      // Check if time between calls to update() is > ON_LENGTH or DECAY_LENGTH
+      if (now >= changeTime) {
+        decayStartTime = now;
+        changeTime = now + changeTimeDelta;
+      }
+    }
+
+    if (decaying && Light::LIGHT_FLASHING == lightMode) {
+      *p_lightLevel = (TAU == 0) ? uint8_t(OFF)
+        : DecayLight::decayLevel(MAX_LEVEL, now - decayStartTime, TAU);
+    }
+  };
+};
+
+template <uint32_t FLAT_LENGTH, uint8_t FLAT_LEVEL, uint32_t PULSE_LENGTH,
+          uint8_t MIN_LEVEL, uint8_t MAX_LEVEL>
+class StaticRotatingLight : public StaticLight
+{
+  // RotatingLight with its timing and levels known at compile time
+
+protected:
+  uint32_t changeTime;     // Keep track of when its time to change modes
+  uint32_t pulseStartTime; // Keep track of when pulse started.
+  bool     pulsing;        // Flag if in pulse or non-pulse mode
+
+public:
+  // See RotatingLight::pulsePhaseStep()
+  static const uint32_t phaseStep = (PULSE_LENGTH == 0) ? 0 :
+    ((0x8000UL << 16) + PULSE_LENGTH - 1)/(PULSE_LENGTH == 0 ? 1 : PULSE_LENGTH);
+
+  StaticRotatingLight() : changeTime(0), pulseStartTime(0), pulsing(false) {;};
+
+  void setup(uint8_t & lightLevelVariable, const uint8_t onLightLevelValue) {
+    StaticLight::setup(lightLevelVariable, onLightLevelValue);
+    *p_lightLevel  = OFF;
+    lightMode      = Light::LIGHT_FLASHING;
+    changeTime     = 0;    // Change right away
+    pulseStartTime = 0;
+    pulsing        = true; // Will cause us to go to pulsing mode right away
+  };
+
+  void flash() {on(); *p_lightLevel = MIN_LEVEL; lightMode = Light::LIGHT_FLASHING;};
+  bool getPulsing() const {return pulsing;};
+  // See RotatingLight::getNextUpdateTime()
+  uint32_t getNextUpdateTime() const {
+    return (pulsing && Light::LIGHT_FLASHING == lightMode) ? 0 : changeTime;
+  };
+
+  void update() {update(millis());};
+  void update(const uint32_t now) {
+    if (now >= changeTime) {
+      uint32_t changeTimeDelta;
+      if (pulsing) {
+        pulsing = false;
+        if (Light::LIGHT_FLASHING == lightMode) {
+          *p_lightLevel = FLAT_LEVEL;
+        }
+        changeTimeDelta = FLAT_LENGTH;
+      } else {
+        pulsing = true;
+        changeTimeDelta = PULSE_LENGTH;
+      }
+      pulseStartTime = changeTime;
+      changeTime = changeTime + changeTimeDelta;
+      // Check if time between calls to update() is > FLAT_LENGTH or PULSE_LENGTH
+      if (now >= changeTime) {
+        pulseStartTime = now;
+        changeTime = now + changeTimeDelta;
+      }
+    }
+
+    if (pulsing && Light::LIGHT_FLASHING == lightMode) {
+      if (PULSE_LENGTH == 0) {
+        *p_lightLevel = MAX_LEVEL;
+      } else {
+#ifdef LUCKY7_FLOAT_LIGHT_MATH
+        *p_lightLevel = RotatingLight::pulseLevelFloat(MIN_LEVEL, MAX_LEVEL,
+                                                       now - pulseStartTime,
+                                                       PULSE_LENGTH);
+#else
+        *p_lightLevel = RotatingLight::pulseLevelFixed(MIN_LEVEL, MAX_LEVEL,
+                                                       now - pulseStartTime,
+                                                       phaseStep);
+#endif
+      }
+    }
+  };
+};
+
+#define SEQUENCE_DECAYTAUS 5 // SequenceLight::DECAY keys last this many tau
+
+class SequenceLight : public StaticLight
+{
+  // Plays a looping track of keyframes kept in flash.  Each key gives how
+  // long it lasts, the light level it ends at, and how the light gets
+  // there from the level of the key before it:
+  //   STEP   - jump to the level at the start of the key and hold it
+  //   LINEAR - ramp in a straight line
+  //   DECAY  - move like DecayLight, quickly at first and then slowly, with
+  //            the key lasting SEQUENCE_DECAYTAUS time constants
+  // For example a strobe double flash every 1.2 seconds is
+  //   const SequenceLight::Key strobeTrack[] PROGMEM = {
+  //     {  40, ON,  SequenceLight::STEP},
+  //     {  80, OFF, SequenceLight::STEP},
+  //     {  40, ON,  SequenceLight::STEP},
+  //     {1040, OFF, SequenceLight::STEP}};
+  //   strobe.setup(lightLevel, ON, strobeTrack, 4);
+  // Only the track position is kept in SRAM.
+
+public:
+  enum Interpolation {
+    STEP = 0,
+    LINEAR,
+    DECAY};
+
+  struct Key {
+    uint16_t length;        // Milliseconds this key lasts
+    uint8_t  level;         // Light level at the end of the key
+    uint8_t  interpolation; // SequenceLight::Interpolation
+  };
+
+private:
+  FRIEND_TEST(SequenceLight, Setup);
+  FRIEND_TEST(SequenceLight, Update);
+  FRIEND_TEST(SequenceLight, EmptyTrack);
+
+protected:
+  const Key * track;     // In PROGMEM
+  uint32_t changeTime;   // When the current key ends
+  uint8_t  keyIndex;     // Current key in track
+  uint8_t  numKeys;      // Length of track
+  uint8_t  fromLevel;    // Light level at the start of the current key
+
+  uint16_t keyLength(const uint8_t i) const {return pgm_read_word(&track[i].length);};
+  uint8_t  keyLevel (const uint8_t i) const {return pgm_read_byte(&track[i].level);};
+  // Light level time milliseconds into the current key
+  uint8_t  levelAt(const uint32_t time) const;
+
+public:
+  SequenceLight() : track(NULL), changeTime(0), keyIndex(0), numKeys(0),
+                    fromLevel(OFF) {;};
+
+  void setup(uint8_t & lightLevelVariable,
+             const uint8_t onLightLevelValue,
+             const Key * trackValues,
+             const uint8_t numberOfKeys);
+
+  // An empty track does not flash
+  void flash() {
+    if (numKeys) {lightMode = Light::LIGHT_FLASHING; *p_lightLevel = levelAt(0);}
+  };
+  uint8_t getKeyIndex() const {return keyIndex;};
+  // STEP keys only change the light level when they start
+  uint32_t getNextUpdateTime() const {
+    if (numKeys == 0) {
+      return 0xFFFFFFFF;
+    }
+    return (Light::LIGHT_FLASHING == lightMode &&
+            STEP != pgm_read_byte(&track[keyIndex].interpolation))
+      ? 0 : changeTime;
+  };
+
+  void update() {update(millis());};
+  void update(const uint32_t now);
+};
+
+// Update light only if its level can have changed since its last update,
+// otherwise count the update as skipped.  Works with any of the light
+// classes above.
+template <class LightType>
+inline void updateIfDue(LightType & light, const uint32_t now)
+{
+  if (now >= light.getNextUpdateTime()) {
+    light.update(now);
+  } else {
+    Light::skippedUpdates++;
+  }
+}
+
+#define LIGHTBANK_MAXCHANNELS 8    // One bit each in LightBank::decayingBits
+#define LIGHTBANK_FULL        0xFF // Channel returned when the bank is full
+
+template <uint8_t N>
+class LightBank
+{
+  // Holds up to N Light/DecayLight/FlashingLight style channels, with
+  // their state in parallel arrays rather than in separate objects, and
+  // updates all of them in one loop against one millis() reading.  Light
+  // levels are written straight into the variables given to
+  // addLight()/addDecayLight(), normally the Lucky7 output bytes.
+  //
+  // Each channel costs 12 bytes plus a bit, with no vtable pointer, and
+  // its timing comes from a DecayLight::Interval table in flash.  The
+  // decay start time is not stored: it is always changeTime minus the
+  // current decayLength.
+  //
+  // Once N channels are added, further adds are ignored and return
+  // LIGHTBANK_FULL, which on(), off(), etc. ignore too.
+
+  static_assert(N > 0 && N <= LIGHTBANK_MAXCHANNELS,
+                "LightBank holds 1 to LIGHTBANK_MAXCHANNELS channels");
+
+private:
+  FRIEND_TEST(LightBank, AddLight);
+  FRIEND_TEST(LightBank, MatchesDecayLight);
+
+  // Do not implement to make sure are never called
+  LightBank(LightBank & other);
+  LightBank & operator=(const LightBank &rhs);
+
+  uint8_t    numChannels;
+  uint8_t    decayingBits;     // Bit set if in decay mode
+  uint8_t  * p_lightLevel [N];
+  uint8_t    onLightLevel [N]; // Value when simply On
+  int8_t     lightMode    [N]; // Light::MODE
+  uint8_t    intervalIndex[N]; // Already wrapped
+  uint8_t    numIntervals [N]; // 0 for On/Off lights
+  uint32_t   changeTime   [N];
+  const DecayLight::Interval * intervals[N]; // In PROGMEM
+
+  bool getDecayingBit(const uint8_t channel) const {
+    return decayingBits & (1 << channel);
+  };
+  uint32_t getLength(const uint8_t channel, const uint8_t j,
+                     const bool decay) const {
+    return DecayLight::duration(pgm_read_word(decay ? &intervals[channel][j].decayLength
+                                                    : &intervals[channel][j].onLength));
+  };
+  uint8_t getMaxLightLevel(const uint8_t channel, const uint8_t j) const {
+    return pgm_read_byte(&intervals[channel][j].maxLightLevel);
+  };
+
+public:
+  LightBank() : numChannels(0), decayingBits(0) {;};
+
+  void setup() {
+    numChannels  = 0;
+    decayingBits = 0;
+  };
+
+  // Both return the new channel number, to be passed to on(), off(), etc.,
+  // or LIGHTBANK_FULL
+  uint8_t addLight(uint8_t & lightLevelVariable, const uint8_t onLightLevelValue) {
+    return addDecayLight(lightLevelVariable, onLightLevelValue, 0, NULL);
+  };
+  uint8_t addDecayLight(uint8_t & lightLevelVariable,
+                        const uint8_t onLightLevelValue,
+                        const uint8_t numberOfValues,
+                        const DecayLight::Interval * intervalValues) {
+    if (numChannels >= N) {
+      return LIGHTBANK_FULL;
+    }
+    const uint8_t i = numChannels++;
+
+    p_lightLevel [i] = &lightLevelVariable;
+    onLightLevel [i] = onLightLevelValue;
+    numIntervals [i] = numberOfValues;
+    intervals    [i] = intervalValues;
+
+    intervalIndex[i] = 0;   // Will be incremented during first call to update
+    changeTime   [i] = 0;   // Change right away
+
+    if (numberOfValues) {
+      // Like DecayLight, start out flashing
+      *p_lightLevel[i] = OFF;
+      lightMode[i]     = Light::LIGHT_FLASHING;
+      decayingBits    |= (1 << i); // Will cause us to go to on mode right away
+    } else {
+      off(i);
+    }
+
+    return i;
+  };
+
+  uint8_t getNumChannels() const {return numChannels;};
+  Light::MODE getLightMode(const uint8_t channel) const {
+    return Light::MODE(lightMode[channel]);
+  };
+  bool getDecaying(const uint8_t channel) const {return getDecayingBit(channel);};
+
+  // Earliest DecayLight::getNextUpdateTime() over the flashing channels,
+  // so the bank goes through updateIfDue() like any other light.  On/Off
+  // channels never need an update.
+  uint32_t getNextUpdateTime() const {
+    uint32_t next = 0xFFFFFFFF;
+    uint8_t i;
+    for (i = 0; i < numChannels; i++) {
+      if (numIntervals[i] == 0) {
+        continue;
+      }
+      if (getDecayingBit(i) && Light::LIGHT_FLASHING == lightMode[i]
+          && *p_lightLevel[i] != OFF) {
+        return 0;
+      }
+      if (changeTime[i] < next) {
+        next = changeTime[i];
+      }
+    }
+    return next;
+  };
+
+  void on(const uint8_t channel) {
+    if (channel >= numChannels) {
+      return;
+    }
+    *p_lightLevel[channel] = onLightLevel[channel];
+    lightMode[channel]     = Light::LIGHT_ON;
+  };
+  void off(const uint8_t channel) {
+    if (channel >= numChannels) {
+      return;
+    }
+    *p_lightLevel[channel] = OFF;
+    lightMode[channel]     = Light::LIGHT_OFF;
+  };
+  void flash(const uint8_t channel) {
+    if (channel >= numChannels || numIntervals[channel] == 0) {
+      return; // On/Off lights do not flash
+    }
+    *p_lightLevel[channel] = getMaxLightLevel(channel, intervalIndex[channel]);
+    lightMode[channel]     = Light::LIGHT_FLASHING;
+  };
+  void toggle(const uint8_t channel) {
+    if (channel >= numChannels) {
+      return;
+    }
+    switch (lightMode[channel]) {
+    case Light::LIGHT_OFF:
+      on(channel);
+      break;
+    case Light::LIGHT_ON:
+      off(channel);
+      break;
+    default:
+      break;
+    }
+  };
+
+  void allOn() {
+    uint8_t i;
+    for (i = 0; i < numChannels; i++) {
+      on(i);
+    }
+  };
+  void allOff() {
+    uint8_t i;
+    for (i = 0; i < numChannels; i++) {
+      off(i);
+    }
+  };
+
+  void update() {update(millis());};
+  void update(const uint32_t now) {
+    // Same state machine as DecayLight::update(), for every channel at once
+    uint8_t i;
+    for (i = 0; i < numChannels; i++) {
+      const uint8_t n = numIntervals[i];
+      if (n == 0) {
+        continue; // On/Off light, nothing to update
+      }
+
+      const uint8_t bit = (1 << i);
+      uint8_t j = intervalIndex[i];
+
+      if (now >= changeTime[i]) {
+        uint32_t changeTimeDelta;
+        if (decayingBits & bit) {
+          decayingBits &= ~bit;
+          j = (j + 1 < n) ? j + 1 : 0;
+          intervalIndex[i] = j;
+          if (lightMode[i] == Light::LIGHT_FLASHING) {
+            *p_lightLevel[i] = getMaxLightLevel(i, j);
+          }
+          changeTimeDelta = getLength(i, j, false);
+        } else {
+          decayingBits |= bit;
+          changeTimeDelta = getLength(i, j, true);
+        }
+        changeTime[i] += changeTimeDelta;
+        // Check if time between calls to update() is > onLength or decayLength
+        if (now >= changeTime[i]) {
+          changeTime[i] = now + changeTimeDelta;
+        }
+      }
+
+      if ((decayingBits & bit) && lightMode[i] == Light::LIGHT_FLASHING) {
+        const uint32_t tauValue =
+          DecayLight::duration(pgm_read_word(&intervals[i][j].tau));
+        if (tauValue == 0) {
+          *p_lightLevel[i] = OFF;
+        } else {
+          const uint32_t decayStartTime = changeTime[i] - getLength(i, j, true);
+          *p_lightLevel[i] = DecayLight::decayLevel(getMaxLightLevel(i, j),
+                                                    now - decayStartTime,
+                                                    tauValue);
+        }
+      }
+    }
+  };
 };
 
 class TimeOfDay
@@ -364,7 +1012,10 @@ private:
   FRIEND_TEST(TimeOfDayTest, Constructor);
   FRIEND_TEST(TimeOfDayTest, getNightDayThreshold);
   FRIEND_TEST(TimeOfDayTest, UpdatePhotocellAvgValues);
+  FRIEND_TEST(TimeOfDayTest, PhotocellDays);
+  FRIEND_TEST(TimeOfDayTest, UpdateAverageFewValues);
   FRIEND_TEST(TimeOfDayTest, UpdateTimeOfDay);
+  FRIEND_TEST(TimeOfDayTest, LearnNight);
   FRIEND_TEST(B29Test, Statemap);
   FRIEND_TEST(B29Test, ProcessKey);
 
@@ -372,15 +1023,19 @@ public:
   enum DayPart {
     EVENING    = 'E', // Light level below threshhold, EVENING timer started, nightStart set.
     NIGHT      = 'N', // Light level below threshhold and EVENING timed out
-    PREDAWN    = 'P', // Starts at (nightStart + lengthOfNight - predawnLength)
+    PREDAWN    = 'P', // Starts at (nightStart + nightForecast - predawnLength)
     MORNING    = 'M', // Light level above threshhold, MORNING timer started, dayStart set
     DAY        = 'D', // Light level above threshhold and MORNING timed out
   } ;
   
   void setup(const uint16_t initialValueMin, const uint16_t initialValueMax,
-             const uint8_t nightDayThresholdPercentageValue);
+             const uint8_t nightDayThresholdPercentageValue,
+             const uint32_t now);
   
-  DayPart updateAverage(const uint16_t lightLevel);
+  DayPart updateAverage(const uint16_t lightLevel) {
+    return updateAverage(lightLevel, millis());
+  };
+  DayPart updateAverage(const uint16_t lightLevel, const uint32_t now);
   DayPart getDayPart();
   uint16_t getNightDayThreshold();
   
@@ -388,6 +1043,7 @@ public:
   uint16_t getPhotocellAvgValueMax()    {return photocellAvgValueMax;};
   uint16_t getPhotocellAvgValueCurrent(){return photocellAvgValueCurrent;};
   uint32_t getLengthOfNight()           {return lengthOfNight;};
+  uint32_t getNightForecast()           {return nightForecast;};
   
   void setUpdateAverageTestMode(bool testModeFlag);
   
@@ -409,12 +1065,37 @@ private:
   uint32_t predawnLength;
   bool     updateAverageTestMode;
   
-#define PHOTOCELLVALUESSIZE LUCKY7_TIME5MIN/LUCKY7_TIME30SEC
-  uint16_t photocellValues[PHOTOCELLVALUESSIZE];
-  uint8_t  photocellValuesIndex;
+  // The 30 second readings since the last 5 minute average, kept as they
+  // come as a sum, min and max, which is all the trimmed mean needs
+  uint32_t photocellValuesSum;
+  uint16_t photocellValuesMin;
+  uint16_t photocellValuesMax;
+  uint8_t  photocellValuesCount;
+
+  // Min and max of the 5 minute averages for each of the last few days,
+  // so one bright flash or a dark spell drops out of the threshold again
+#define PHOTOCELLDAYS 5
+#define PHOTOCELLDAYUPDATES LUCKY7_TIME24HOUR/LUCKY7_TIME5MIN
+  struct PhotocellDay {
+    uint16_t min;
+    uint16_t max;
+  };
+  PhotocellDay photocellDays[PHOTOCELLDAYS];
+  uint8_t  photocellDaysIndex;
+  uint16_t photocellDayUpdates;
   
+  // The last few nights' lengths in minutes, oldest at nightsIndex once
+  // there are NIGHTSSIZE of them, from which the coming night is forecast
+#define NIGHTSSIZE 4
+  uint16_t nights[NIGHTSSIZE];
+  uint8_t  nightsIndex;
+  uint8_t  nightsCount;
+  uint32_t nightForecast;
+
   void updatePhotocellAvgValues(uint16_t photocellAvgValue);
-  void updateTimeOfDay();
+  void learnNight(const uint32_t length);
+  void updateTimeOfDay() {updateTimeOfDay(millis());};
+  void updateTimeOfDay(const uint32_t now);
   DayPart currentDayPart;
 };
 
@@ -440,8 +1121,10 @@ private:
   uint32_t motorUpStartTime;
   uint32_t motorDownStartTime;
   
-  void motorUpUpdate();
-  void motorDownUpdate();
+  void motorUpUpdate()   {motorUpUpdate(millis());};
+  void motorUpUpdate(const uint32_t now);
+  void motorDownUpdate() {motorDownUpdate(millis());};
+  void motorDownUpdate(const uint32_t now);
   void motorUpStop();
   void motorDownStop();
 
@@ -449,13 +1132,15 @@ private:
 public:
   void setup(uint8_t & oUp, uint8_t & p_oDown);
 
-  void motorUpStart();
-  void motorDownStart();
+  // now is the millis() the motor's start delay and timeout count from
+  void motorUpStart(const uint32_t now);
+  void motorDownStart(const uint32_t now);
 
   uint8_t getMotorUpPower()   {return *p_outputUp;};
   uint8_t getMotorDownPower() {return *p_outputDown;};
 
-  void motorUpdate();
+  void motorUpdate() {motorUpdate(millis());};
+  void motorUpdate(const uint32_t now);
 
   void motorStop() {motorUpStop(); motorDownStop();};
 
@@ -463,6 +1148,156 @@ public:
   bool getInMotorDownMode() {return inMotorDownMode;};
 };
 
+// Sensor filters.  Each takes ADC samples with add() and keeps its result
+// up to date as it goes, so value() is just a read.  reset() makes the
+// filter look as if it had only ever seen sample.  value() is in the
+// samples' units times 2^extraBits.
+
+template <uint8_t N>
+class RunningAverageFilter
+{
+  // Mean of the last N samples, from a running sum
+public:
+  static const uint8_t extraBits = 0;
+
+  void reset(const uint16_t sample) {
+    uint8_t i;
+    for (i = 0; i < N; i++) {
+      samples[i] = sample;
+    }
+    sum   = uint32_t(sample)*N;
+    index = 0;
+  };
+  void add(const uint16_t sample) {
+    sum = sum - samples[index] + sample;
+    samples[index] = sample;
+    index = (index + 1 < N) ? index + 1 : 0;
+  };
+  uint16_t value() const {return sum/N;};
+
+private:
+  uint16_t samples[N];
+  uint32_t sum;
+  uint8_t  index;
+};
+
+template <uint8_t SHIFT>
+class EMAFilter
+{
+  // Exponential moving average, each sample weighted 1/2^SHIFT
+public:
+  static const uint8_t extraBits = 0;
+
+  void reset(const uint16_t sample) {state = uint32_t(sample) << SHIFT;};
+  void add(const uint16_t sample) {state = state - (state >> SHIFT) + sample;};
+  uint16_t value() const {return state >> SHIFT;};
+
+private:
+  uint32_t state; // Average times 2^SHIFT
+};
+
+// Sort two values in place, a step of a sorting network
+inline void lucky7CompareSwap(uint16_t & a, uint16_t & b) {
+  if (a > b) {
+    const uint16_t t = a;
+    a = b;
+    b = t;
+  }
+}
+
+// Sort v[0..N-1] with a fixed network of compare/swaps, N = 3 or 5
+template <uint8_t N> void lucky7SortingNetwork(uint16_t * v);
+template <> inline void lucky7SortingNetwork<3>(uint16_t * v) {
+  lucky7CompareSwap(v[0], v[1]);
+  lucky7CompareSwap(v[1], v[2]);
+  lucky7CompareSwap(v[0], v[1]);
+}
+template <> inline void lucky7SortingNetwork<5>(uint16_t * v) {
+  lucky7CompareSwap(v[0], v[1]);
+  lucky7CompareSwap(v[3], v[4]);
+  lucky7CompareSwap(v[2], v[4]);
+  lucky7CompareSwap(v[2], v[3]);
+  lucky7CompareSwap(v[1], v[4]);
+  lucky7CompareSwap(v[0], v[3]);
+  lucky7CompareSwap(v[0], v[2]);
+  lucky7CompareSwap(v[1], v[3]);
+  lucky7CompareSwap(v[1], v[2]);
+}
+
+template <uint8_t N>
+class MedianFilter
+{
+  // Median of the last N samples, N = 3 or 5.  Throws out single spikes,
+  // e.g. a car's headlights sweeping a photocell.
+public:
+  static const uint8_t extraBits = 0;
+
+  void reset(const uint16_t sample) {
+    uint8_t i;
+    for (i = 0; i < N; i++) {
+      samples[i] = sample;
+    }
+    median = sample;
+    index  = 0;
+  };
+  void add(const uint16_t sample) {
+    samples[index] = sample;
+    index = (index + 1 < N) ? index + 1 : 0;
+    uint16_t sorted[N];
+    uint8_t i;
+    for (i = 0; i < N; i++) {
+      sorted[i] = samples[i];
+    }
+    lucky7SortingNetwork<N>(sorted);
+    median = sorted[N/2];
+  };
+  uint16_t value() const {return median;};
+
+private:
+  uint16_t samples[N];
+  uint16_t median;
+  uint8_t  index;
+};
+
+template <uint8_t EXTRABITS, class Filter>
+class OversamplingFilter
+{
+  // Sums 4^EXTRABITS samples and hands the sum, decimated to EXTRABITS more
+  // bits than a sample, to Filter.  With a little noise on the input that
+  // gives EXTRABITS more effective bits, at 1/4^EXTRABITS the sample rate.
+public:
+  static const uint8_t extraBits = EXTRABITS + Filter::extraBits;
+
+  void reset(const uint16_t sample) {
+    filter.reset(sample << EXTRABITS);
+    sum   = 0;
+    count = 0;
+  };
+  void add(const uint16_t sample) {
+    sum += sample;
+    if (++count == (1 << (2*EXTRABITS))) {
+      filter.add(sum >> EXTRABITS);
+      sum   = 0;
+      count = 0;
+    }
+  };
+  uint16_t value() const {return filter.value();};
+
+private:
+  Filter   filter;
+  uint32_t sum;
+  uint8_t  count;
+};
+
+// Filter used for each sensor, picked here at compile time.  The
+// photocells are oversampled for LUCKY7_PHOTOCELLEXTRABITS more bits, so
+// TimeOfDay sees dusk, when they read only a few ADC units, in finer
+// steps.  The battery's low and reset voltages are many ADC units apart,
+// so it keeps a plain average.
+typedef OversamplingFilter<LUCKY7_PHOTOCELLEXTRABITS,
+                           RunningAverageFilter<AVECNT> > PhotocellFilter;
+typedef RunningAverageFilter<AVECNT> BatteryFilter;
+
 class  IRrecvMock;
 class  decode_results;
 
@@ -476,20 +1311,81 @@ private:
   FRIEND_TEST(Lucky7Test, Loop);
   FRIEND_TEST(Lucky7Test, Photocell1and2andBatteryVoltage);
   FRIEND_TEST(Lucky7Test, OutputMoveTo);
+  FRIEND_TEST(Lucky7Test, OutputCurveDither);
+  FRIEND_TEST(Lucky7Test, Crossfade);
+  FRIEND_TEST(Lucky7Test, CommitOutputs);
+  FRIEND_TEST(Lucky7Test, OutputChannels);
+  FRIEND_TEST(Lucky7Test, SampleSensors);
+  FRIEND_TEST(Lucky7Test, AdcRead);
+  FRIEND_TEST(Lucky7Test, IRKeyEventLoopStalled);
   FRIEND_TEST(B29Test, Statemap);
+  FRIEND_TEST(B29Test, Setup);
   FRIEND_TEST(Integration, CycleThroughDay);
   
-  uint16_t photocell(uint16_t * pc);
-  uint32_t irTimeout;
-  uint16_t pc1[AVECNT], pc2[AVECNT], bc[AVECNT];
-  uint8_t aveptr;
-  void outputMoveTo(const uint8_t outputPin, uint8_t & currentValue,
-                    uint8_t targetValue, const uint16_t stepDelay);
-
-  uint8_t o1Saved,o2Saved,o3Saved,o4Saved,o5Saved,o6Saved,o7Saved;
+  // Key being held, and when it was pressed and last seen, see irLoop()
+  uint32_t irHeldKey;
+  uint32_t irPressTime;
+  uint32_t irLastTime;
+  PhotocellFilter pc1, pc2;
+  BatteryFilter   bc;
+
+  // Sensor sampling.  loop() asks for a sample of each sensor every
+  // sampleInterval milliseconds.  The ADC interrupt converts them one after
+  // the other, and a later loop() adds the values to pc1, pc2 and bc.
+  uint16_t sampleInterval[LUCKY7_NUMSENSORS];
+  uint32_t sampleTime    [LUCKY7_NUMSENSORS]; // When the next sample is due
+  uint8_t  samplesPrimed; // Bit set for each sensor with its first sample
+  void sampleSensors(const uint32_t now);
+
+  // Ramps started by outputMoveTo(), one per output channel
+  uint16_t rampActive;       // Bit set for each output with a ramp running
+  uint8_t  rampTarget[LUCKY7_NUMOUTPUTS];    // Level the output is moving to
+  uint16_t rampStepDelay[LUCKY7_NUMOUTPUTS]; // Microseconds per level step
+  uint16_t rampCarry[LUCKY7_NUMOUTPUTS];     // Microseconds already spent on
+                                             // the next step
+  uint32_t loopTime;         // millis() at the last loop()
+  void rampOutputs(const uint32_t now);
+
+  // Crossfade started by crossfade(), for the PWM outputs o1..o7
+  uint8_t  oShown[7];        // Level last written, before OutputCurve
+  uint8_t  crossfadeFrom[7]; // oShown when the crossfade was asked for
+  uint32_t crossfadeStart;
+  uint16_t crossfadeLength;  // 0 when not crossfading
+  bool     crossfadePending; // Start crossfade on the next loop()
+  uint8_t  crossfadeOutputs; // Bit output-1 set for each that crossfades
+  // How far through the crossfade now is, in 1/256ths
+  uint16_t crossfadeFraction(const uint32_t now);
+  uint8_t  shownLevel(const uint8_t output, const uint8_t level,
+                      const uint16_t fade);
+
+  uint8_t oSaved[LUCKY7_NUMOUTPUTS]; // See saveOutputState()
+
+  // Output commit.  loop() works out every pin's value first, then
+  // commitOutputs() writes only those that changed, so outputs change
+  // together at the end of the loop.
+  uint8_t  oWritten[LUCKY7_NUMOUTPUTS]; // PWM level, or LOW/HIGH, last
+                                        // written to each pin
+  uint16_t oDirty;      // Bit set for each pin to write even if unchanged
+  void commitOutputs(const uint8_t * value);
+
+  uint8_t oCurve[7];  // OutputCurve of o1..o7
+  uint8_t oDither[7]; // 1/16ths of a PWM level carried to the next loop()
+  // PWM level to write for output 1..7 at light level, see setOutputCurve()
+  uint8_t outputLevel(const uint8_t output, const uint8_t level);
 
 public:
 
+  // How light levels in o1..o7 map to PWM.  CURVE_LINEAR writes them as
+  // they are.  The others are gamma curves (2.2 for LEDs, a milder 1.6 for
+  // bulbs, whose filaments already respond non-linearly) giving 12 bit
+  // PWM levels, and the 4 bits below the 8 the PWM has are dithered over
+  // successive calls to loop().
+  enum OutputCurve {
+    CURVE_LINEAR = 0,
+    CURVE_LED,
+    CURVE_BULB
+  };
+
   enum BoardLightMode {
     LIGHT_ON,
     LIGHT_OFF,
@@ -499,71 +1395,107 @@ public:
 
   void boardLight(BoardLightMode mode, void (lightOn)(), void (lightOff)());
 
+  // Light level of each output channel.  Sketches hand hw.o5 etc. to a
+  // light's setup(), and loops go through output(0..8).
   uint8_t o1,o2,o3,o4,o5,o6,o7,o8,o13;
+  // o1..o7, o8, o13 by output channel number, 0..8
+  uint8_t & output(const uint8_t channel);
+
+  // Pin of output channel, and whether it can dim (PWM) or is just on/off
+  static uint8_t outputPin(const uint8_t channel);
+  static bool    outputDimmable(const uint8_t channel);
+
+  // Pin writes made by loop().  Pins are only written when their value
+  // changes, so this grows far slower than the number of loops.
+  uint32_t outputWrites;
 
 
   void setup();
+  void setOutputCurve(const uint8_t output, const OutputCurve curve);
+  // Whether output, 1..7, takes part in crossfade().  All do after setup().
+  // Outputs that drive motors should not, or they ramp instead of
+  // switching cleanly.
+  void setCrossfade(const uint8_t output, const bool fade);
+  // Milliseconds between samples of sensor, LUCKY7_SENSORPHOTOCELL1 etc.
+  void setSampleInterval(const uint8_t sensor, const uint16_t interval) {
+    sampleInterval[sensor] = interval;
+  };
+  // analogRead() for sketches, without waiting.  An analogRead() while the
+  // sensor sampler is converting would switch the ADC's channel under it,
+  // so the sampler converts pin after its sensors instead.  The first call
+  // asks for the conversion and returns false.  A call on a later pass,
+  // once it is done, returns true with the result in value.
+  bool adcRead(const uint8_t pin, uint16_t & value);
+  // PWM level, in 1/16ths, for light level on curve
+  static uint16_t outputCurveValue(const uint8_t curve, const uint8_t level);
+
+  // What irLoop() makes of each code from the IR receiver.  The first code
+  // of a key is a KEY_PRESS.  While the key is held the remote sends the
+  // code again, or NEC's REPEAT code, every LUCKY7_IRREPEATTIME or so.
+  // These are KEY_REPEATs, and KEY_HOLDs once the key has been held for
+  // LUCKY7_IRHOLDTIME, for things that should keep going while it is held.
+  enum KeyEventType {
+    KEY_NONE = 0,
+    KEY_PRESS,
+    KEY_REPEAT,
+    KEY_HOLD
+  };
+  struct KeyEvent {
+    uint32_t key;  // Key pressed or held, 0 if none
+    uint32_t time; // millis() when the key was pressed
+    uint8_t  type; // KeyEventType
+  };
+
+  // What one pass of the sketch's loop() works from.  loop() reads the time,
+  // the filtered sensors and any IR key once into frame, so the state map,
+  // the lights and the status line all see the same values.
+  struct Frame {
+    uint32_t now;            // millis() at the start of the pass
+    uint32_t irKey;          // IR key received, 0 if none
+    uint8_t  irKeyEvent;     // What irKey is doing, KeyEventType
+    uint16_t photocell1;
+    uint16_t photocell2;
+    float    batteryVoltage;
+  };
+  Frame frame;
+  // A Frame at now from the filtered sensors, with no key
+  Frame captureFrame(const uint32_t now);
 
+  // Returns a newly pressed IR key, 0 if none.  frame has held ones too.
   uint32_t loop();
-  uint32_t irLoop();
+  KeyEvent irLoop() {return irLoop(millis());};
+  KeyEvent irLoop(const uint32_t now);
+  // What irLoop() makes of code, received at millis() time
+  KeyEvent irKeyEvent(const uint32_t code, const uint32_t time);
+  // millis() time of a code that ended at micros() codeMicros, taken at
+  // millis() now and micros() nowMicros
+  static uint32_t irCodeTime(const uint32_t now, const uint32_t nowMicros,
+                             const uint32_t codeMicros) {
+    return now - (nowMicros - codeMicros)/1000;
+  };
+
+  // Fade o1..o7 from what they show now to whatever the lights set them to
+  // over the next length milliseconds.  The lights keep running meanwhile.
+  void crossfade(const uint16_t length);
 
+  // Save o1..o13 and later put them back, e.g. around an override of the lights
   void saveOutputState();
   void setOutputStateFromSaved();
+  void allOutputsOff();
+
+  void outputOn(const uint8_t channel)  {output(channel) = ON;};
+  void outputOff(const uint8_t channel) {output(channel) = OFF;};
+  void outputSet(const uint8_t channel, const uint8_t value) {output(channel) = value;};
+  void outputToggle(const uint8_t channel) {
+    uint8_t & value = output(channel);
+    value = value ? OFF : ON;
+  };
+  // Ramp the output to targetValue, one level every stepDelay microseconds.
+  // Returns right away, and each loop() moves the output on.
+  void outputMoveTo(const uint8_t channel, const uint8_t targetValue,
+                    const uint16_t stepDelay);
 
-  void o1On()             {o1 = ON;}
-  void o1Set(uint8_t v)   {o1 = v;}
-  void o1Off()            {o1 = 0;}
-  void o1MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o1Toggle()         {o1 = o1?OFF:ON;};       
-  
-  void o2On()             {o2 = ON;}
-  void o2Set(uint8_t v)   {o2 = v;}
-  void o2Off()            {o2 = 0;}
-  void o2MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o2Toggle()         {o2 = o2?OFF:ON;};       
-
-  void o3On()             {o3 = ON;}
-  void o3Set(uint8_t v)   {o3 = v;}
-  void o3Off()            {o3 = 0;}
-  void o3MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o3Toggle()         {o3 = o3?OFF:ON;};       
-
-  void o4On()             {o4 = ON;}
-  void o4Set(uint8_t v)   {o4 = v;}
-  void o4Off()            {o4 = 0;}
-  void o4MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o4Toggle()         {o4 = o4?OFF:ON;};       
-
-  void o5On()             {o5 = ON;}
-  void o5Set(uint8_t v)   {o5 = v;}
-  void o5Off()            {o5 = 0;}
-  void o5MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o5Toggle()         {o5 = o5?OFF:ON;};       
-
-  void o6On()             {o6 = ON;}
-  void o6Set(uint8_t v)   {o6 = v;}
-  void o6Off()            {o6 = 0;}
-  void o6MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o6Toggle()         {o6 = o6?OFF:ON;};       
-
-  void o7On()             {o7 = ON;}
-  void o7Set(uint8_t v)   {o7 = v;}
-  void o7Off()            {o7 = 0;}
-  void o7MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o7Toggle()         {o7 = o7?OFF:ON;};       
-
-  void o8On()             {o8 = ON;}
-  void o8Set(uint8_t v)   {o8 = v;}
-  void o8Off()            {o8 = 0;}
-  void o8MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o8Toggle()         {o8 = o8?OFF:ON;};       
-
-  void o13On()            {o13 = ON;}
-  void o13Set(uint8_t v)  {o13 = v;}
-  void o13Off()           {o13 = 0;}
-  void o13MoveTo(uint8_t v, const uint16_t stepdelay);
-  void o13Toggle()        {o13 = o13?OFF:ON;};       
-
+  // In ADC units times 2^PhotocellFilter::extraBits
   uint16_t photocell1();
   uint16_t photocell2();
 
@@ -36,7 +36,7 @@ void B29Test::SetUp()
     .Times(11);
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(1);
+    .Times(0);
 
   IRrecvMock * irrecvMock = irrecvMockInstance();
   EXPECT_CALL(*irrecvMock, enableIRIn())
@@ -371,26 +371,18 @@ TEST_F(B29Test, UpdateLights) {
 
 
   // Override aircraft light setup so timeing is correct for tests below
-  positionOnLengths[0]         = 250;
-  positionDecayLengths[0]      = 1100-250;
-  positionMaxLightLevels[0]    = ON;
-  positionTauInMilliseconds[0] = 450;
+  const DecayLight::Interval testPositionIntervals[1] = {
+    {LUCKY7_DURATION(250), LUCKY7_DURATION(1100-250), LUCKY7_DURATION(450), ON}};
 
   // Landing is on for 5 minutes, off for 5 minutes during the day
 
   setupStatusLights();
   setupLightingAndMotorChannels();
+  position.setIntervals(testPositionIntervals);
 
-  // Override red and blue light's setup so timeing is correct for tests below
-  blueLight.slowLight.onLengthValues [0] = 2000;
-  blueLight.slowLight.offLengthValues[0] =   10;
-  blueLight.fastLight.onLengthValues [0] = 1000;
-  blueLight.fastLight.offLengthValues[0] =   10;
-
-  redLight .slowLight.onLengthValues [0] = 2000;
-  redLight .slowLight.offLengthValues[0] =   10;
-  redLight .fastLight.onLengthValues [0] = 1000;
-  redLight .fastLight.offLengthValues[0] =   10;
+  // Red and blue lights blink fast, on for 125 ms and off for 125 ms.
+  // Each call to updateChannels() below is more than a blink apart, so
+  // each starts the next on or off part of the blink.
 
   // On construction, all lights and motors are off
   EXPECT_EQ(OFF, ident());
@@ -407,13 +399,13 @@ TEST_F(B29Test, UpdateLights) {
   //   on-time is 250 msecs
   // on/off lights are whatever they are set to
   // possitiona nd landing should be ready to delay blink
-  // Fast blinking lights are still on as have 1000 msec on time
+  // Fast blinking lights have just turned on
   // Motor has 2 second delay before it starts
   arduinoMock->setMillisRaw(200);
   ident.on();
   illum.on();
   formation.on();
-  upDownMotor.motorUpStart();
+  upDownMotor.motorUpStart(200);
   redLight.setToFast();
   blueLight.setToFast();
 
@@ -421,7 +413,7 @@ TEST_F(B29Test, UpdateLights) {
   EXPECT_EQ(ON, ident());
   EXPECT_EQ(ON, landing());
   EXPECT_EQ(ON, illum());
-  EXPECT_EQ(positionMaxLightLevels[0], position());
+  EXPECT_EQ(ON, position());
   EXPECT_EQ(ON, formation());
   EXPECT_EQ(OFF, hw.o3); 
   EXPECT_EQ(OFF, hw.o7);           
@@ -431,7 +423,7 @@ TEST_F(B29Test, UpdateLights) {
   // At time = 250+450 = 700 ms decay lights (with 250 ms on-time and tau = 450 ms)
   // are decaying
   // on/off lights don't change.
-  // Fast blinking lights are still on as have 1000 msec on time
+  // Fast blinking lights have turned off
   // Motor still not started
 
   arduinoMock->setMillisRaw(250+450);
@@ -439,16 +431,16 @@ TEST_F(B29Test, UpdateLights) {
   EXPECT_EQ(ON, ident()); 
   EXPECT_EQ(ON, landing());
   EXPECT_EQ(ON, illum());
-  EXPECT_EQ(int(positionMaxLightLevels[0]*.368+.5), position());
+  EXPECT_EQ(int(ON*.368+.5), position());
   EXPECT_EQ(ON, formation());
   EXPECT_EQ(OFF, hw.o3); 
   EXPECT_EQ(OFF, hw.o7);           
-  EXPECT_EQ(ON, blueLight());
-  EXPECT_EQ(ON, redLight());
+  EXPECT_EQ(OFF, blueLight());
+  EXPECT_EQ(OFF, redLight());
 
   // At time = 1000 msecs decay lights are still decaying
   // on/off lights don't change.
-  // Fast blinking lights have just turned off
+  // Fast blinking lights have turned back on
   // Motor still not started
 
   arduinoMock->setMillisRaw(1000);
@@ -456,16 +448,16 @@ TEST_F(B29Test, UpdateLights) {
   EXPECT_EQ(ON, ident());
   EXPECT_EQ(ON, landing());
   EXPECT_EQ(ON, illum());
-  EXPECT_GT(positionMaxLightLevels[0], position());
+  EXPECT_GT(ON, position());
   EXPECT_EQ(ON, formation());
   EXPECT_EQ(OFF, hw.o3); 
   EXPECT_EQ(OFF, hw.o7);           
-  EXPECT_EQ(OFF, blueLight());
-  EXPECT_EQ(OFF, redLight());
+  EXPECT_EQ(ON, blueLight());
+  EXPECT_EQ(ON, redLight());
 
   // At time = 1100 msecs decay lights are back full on
   // on/off lights don't change.
-  // Fast blinking lights are on
+  // Fast blinking lights are still on
   // Motor still not started
 
   arduinoMock->setMillisRaw(1100);
@@ -473,7 +465,7 @@ TEST_F(B29Test, UpdateLights) {
   EXPECT_EQ(ON, ident());
   EXPECT_EQ(ON, landing());
   EXPECT_EQ(ON, illum());
-  EXPECT_EQ(positionMaxLightLevels[0], position());
+  EXPECT_EQ(ON, position());
   EXPECT_EQ(ON, formation());
   EXPECT_EQ(OFF, hw.o3); 
   EXPECT_EQ(OFF, hw.o7);           
@@ -528,7 +520,7 @@ TEST_F(B29Test, Setup) {
     .Times(11);
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(1);
+    .Times(0);
 
   IRrecvMock * irrecvMock = irrecvMockInstance();
   EXPECT_CALL(*irrecvMock, enableIRIn())
@@ -539,6 +531,8 @@ TEST_F(B29Test, Setup) {
   setup();
  
   EXPECT_EQ(MODE_BATTERYLOW, mode);
+  // Up and down motors, o3 and o7, are left out of crossfades
+  EXPECT_EQ(0x3B, hw.crossfadeOutputs);
 
   releaseSerialMock();
   releaseArduinoMock();
@@ -820,7 +814,7 @@ TEST_F(B29Test, SetEveningInit) {
 
   ArduinoMock * arduinoMock = arduinoMockInstance();
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(5);
+    .Times(1); // Read once per pass, then passed to each light
 
   setupStatusLights();
   setupLightingAndMotorChannels();
@@ -849,7 +843,7 @@ TEST_F(B29Test, SetNightInit) {
 
   ArduinoMock * arduinoMock = arduinoMockInstance();
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(5);
+    .Times(1); // Read once per pass, then passed to each light
 
   setupStatusLights();
   setupLightingAndMotorChannels();
@@ -898,7 +892,7 @@ TEST_F(B29Test, SetMorningInit) {
 
   ArduinoMock * arduinoMock = arduinoMockInstance();
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(4);
+    .Times(1); // Read once per pass, then passed to each light
 
   allLightsOff();
   redLight.off();
@@ -920,7 +914,7 @@ TEST_F(B29Test, SetMorningInit) {
 TEST_F(B29Test, SetDayInit) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(4);
+    .Times(1); // Read once per pass, then passed to each light
 
   setupStatusLights();
 
@@ -1514,6 +1508,7 @@ TEST_F(B29Test, ProcessKey) {
 
   EXPECT_FALSE(upDownMotor.getInMotorUpMode());
   EXPECT_FALSE(upDownMotor.getInMotorDownMode());
+  hw.frame.now = millis(); // As hw.loop() sets it before processKey()
   processKey('U');
   updateChannels();
   EXPECT_TRUE(upDownMotor.getInMotorUpMode());
@@ -1533,6 +1528,7 @@ TEST_F(B29Test, ProcessKey) {
 
   EXPECT_FALSE(upDownMotor.getInMotorUpMode());
   EXPECT_FALSE(upDownMotor.getInMotorDownMode());
+  hw.frame.now = millis(); // As hw.loop() sets it before processKey()
   processKey('D');
   updateChannels();
   EXPECT_FALSE(upDownMotor.getInMotorUpMode());
@@ -1552,6 +1548,24 @@ TEST_F(B29Test, ProcessKey) {
 
 }
 
+TEST_F(B29Test, RemoteKey) {
+  // Each remote's codes come out as the keys processKey() takes
+  for (uint8_t i = 0; i < REMOTEKEYS; i++) {
+    EXPECT_EQ(remoteKeys[i].key, remoteKey(remoteKeys[i].code))
+      << "i = " << int(i);
+  }
+  EXPECT_EQ('0', remoteKey(RC65X_KEY0));
+  EXPECT_EQ('8', remoteKey(RM_YD065_KEY8));
+  EXPECT_EQ('^', remoteKey(RC65X_KEYUP));
+  EXPECT_EQ('U', remoteKey(RM_YD065_KEYPROGUP));
+
+  // Anything else, like keys from Serial, is left alone
+  EXPECT_EQ('0', remoteKey('0'));
+  EXPECT_EQ('P', remoteKey('P'));
+  EXPECT_EQ(RC65X_KEYMENU, remoteKey(RC65X_KEYMENU));
+  EXPECT_EQ(RM_YD065_KEYBLUE, remoteKey(RM_YD065_KEYBLUE));
+}
+
 TEST_F(B29Test, Statemap) {
 
   size_t i;
@@ -1603,9 +1617,7 @@ TEST_F(B29Test, Statemap) {
 
   // Get batter level to one that is less than reset value but higher than battery low value
   // Only in startup mode would this kick the state out of low-battery mode
-  for (i = 0; i < AVECNT; i++) {
-    hw.bc[i] = uint16_t(((getBatteryLowValue()+getBatteryLowResetValue())/2.0)/float(BVSCALE) + .5);
-  }
+  hw.bc.reset(uint16_t(((getBatteryLowValue()+getBatteryLowResetValue())/2.0)/float(BVSCALE) + .5));
 
   EXPECT_EQ(MODE_BATTERYLOW, mode);
   EXPECT_EQ(TimeOfDay::DAY, timeOfDay.getDayPart());
@@ -1633,11 +1645,9 @@ TEST_F(B29Test, Statemap) {
   // Normal path where state set on basis of timeOfDay.updateAverage(lightLevel)
   //----------------------------------------------------------------------------
 
-  for (i = 0; i < AVECNT; i++) {
-    hw.pc1[i] = 1000;
-    hw.pc2[i] = 1000;
-    hw.bc[i] = uint16_t((getBatteryLowResetValue()+0.1)/float(BVSCALE) + .5);
-  }
+  hw.pc1.reset(1000);
+  hw.pc2.reset(1000);
+  hw.bc.reset(uint16_t((getBatteryLowResetValue()+0.1)/float(BVSCALE) + .5));
 
   EXPECT_EQ(TimeOfDay::DAY, timeOfDay.getDayPart());
 
@@ -1704,9 +1714,7 @@ TEST_F(B29Test, Statemap) {
   EXPECT_EQ(TimeOfDay::PREDAWN, mode);
 
 
-  for (i = 0; i < AVECNT; i++) {
-    hw.bc[i] = uint16_t((getBatteryLowValue()/2.0)/float(BVSCALE) + .5);
-  }
+  hw.bc.reset(uint16_t((getBatteryLowValue()/2.0)/float(BVSCALE) + .5));
 
   for (i = 0; i < numDayParts; i++) {
 
@@ -1737,9 +1745,7 @@ TEST_F(B29Test, Statemap) {
   EXPECT_EQ(MODE_BATTERYLOW, mode);
 
 
-  for (i = 0; i < AVECNT; i++) {
-    hw.bc[i] = uint16_t((getBatteryLowResetValue()+0.1)/float(BVSCALE) + .5);
-  }
+  hw.bc.reset(uint16_t((getBatteryLowResetValue()+0.1)/float(BVSCALE) + .5));
 
   for (i = 0; i < numDayParts; i++) {
 
@@ -1776,9 +1782,7 @@ TEST_F(B29Test, Statemap) {
   // Set values so overrideBatteryLow() will return true
   hw.o3 = ON;
   // Set battery so batteryVoltage >= BATTERYLOW
-  for (i = 0; i < AVECNT; i++) {
-    hw.bc[i] = uint16_t((getBatteryLowValue())/float(BVSCALE) + .5);
-  }
+  hw.bc.reset(uint16_t((getBatteryLowValue())/float(BVSCALE) + .5));
   for (i = 0; i < numDayParts; i++) {
     mode = dayParts[i];
     for (j = 0; j < numDayParts; j++) {
@@ -1793,9 +1797,7 @@ TEST_F(B29Test, Statemap) {
   // Set values so overrideBatteryLow() will return true
   hw.o3 = ON;
   // Set battery so batteryVoltage <= BATTERYLOW
-  for (i = 0; i < AVECNT; i++) {
-    hw.bc[i] = uint16_t((getBatteryLowValue()/2)/float(BVSCALE) + .5);
-  }
+  hw.bc.reset(uint16_t((getBatteryLowValue()/2)/float(BVSCALE) + .5));
   for (i = 0; i < numDayParts; i++) {
     mode = dayParts[i];
     for (j = 0; j < numDayParts; j++) {
@@ -1811,9 +1813,7 @@ TEST_F(B29Test, Statemap) {
   hw.o3 = OFF;
   hw.o7 = OFF;
   // Set battery so batteryVoltage >= BATTERYLOWRESET
-  for (i = 0; i < AVECNT; i++) {
-    hw.bc[i] = uint16_t((getBatteryLowResetValue())/float(BVSCALE) + .5);
-  }
+  hw.bc.reset(uint16_t((getBatteryLowResetValue())/float(BVSCALE) + .5));
   for (i = 0; i < numDayParts; i++) {
     mode = dayParts[i];
     for (j = 0; j < numDayParts; j++) {
@@ -1828,9 +1828,7 @@ TEST_F(B29Test, Statemap) {
   hw.o3 = OFF;
   hw.o7 = OFF;
   // Set battery so batteryVoltage <= BATTERYLOW
-  for (i = 0; i < AVECNT; i++) {
-    hw.bc[i] = uint16_t((getBatteryLowValue()/2)/float(BVSCALE) + .5);
-  }
+  hw.bc.reset(uint16_t((getBatteryLowValue()/2)/float(BVSCALE) + .5));
   for (i = 0; i < numDayParts; i++) {
     mode = dayParts[i];
     for (j = 0; j < numDayParts; j++) {
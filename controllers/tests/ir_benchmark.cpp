@@ -0,0 +1,460 @@
+// Host side replay of IR receiver captures through the receiver's pin
+// change interrupt handler and IRrecv::decode(), to see how well codes
+// decode, how often noise turns into a key, and how long decoding takes.
+// Timings are for whatever machine runs "make bench", not the ATmega328.
+//
+// With no arguments the captures are made up here from the protocols'
+// timings: clean and jittered NEC codes and repeats and Sony codes, as
+// the RM-YD065 sends, plus partial bursts and noise.  Files of real
+// captures can be given as arguments, one capture per line:
+//
+//   <expected> <mark> <space> <mark> ... <mark>
+//
+// with widths in microseconds (signs are ignored, so IRrecvDump's raw
+// output can be pasted in), and <expected> the value decode() should give
+// in hex, REPEAT, or - if the capture should not decode at all.  Lines
+// starting with # are skipped.
+//
+// Made up captures are expected to decode to the code that was sent, or
+// to some UNKNOWN code for the RC6 ones decodeHash() takes.  Exits with 1
+// if a clean one does not, if fewer than JITTERFLOOR percent of any
+// protocol's 10% jittered ones do, if any capture decodes to a code other
+// than the one sent, or if more than FALSEKEYCEILING percent of partial
+// bursts and noise decode at all, so "make bench" fails when the decoder
+// gets worse.
+#include "IRremote.cpp"
+#include "RMYD065.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The receiver pin, as the interrupt handler sees it
+unsigned long hostMicros = 0;
+uint8_t       hostLevel  = SPACE;
+
+unsigned long micros(void) {return hostMicros;}
+unsigned long millis(void) {return hostMicros/1000;}
+int  digitalRead(uint8_t) {return hostLevel;}
+void digitalWrite(uint8_t, uint8_t) {}
+void pinMode(uint8_t, uint8_t) {}
+
+#define IRPIN 2 // Any pin will do, digitalRead() above ignores it
+#define NOTHING 0 // Capture::expected when nothing should decode
+#define ANYCODE 1 // Capture::expected when any hash will do
+#define REPLAYGAP 40000 // Microseconds of quiet before each capture
+#define ENDGAP (_GAP + 1000) // Of that, after the capture, to end it
+#define SONYREPEATGAP 20000 // Before a Sony code sent again for a held key
+#define JITTERFLOOR 95 // Percent of 10% jittered codes that must decode
+#define FALSEKEYCEILING 2 // Percent of partial bursts and noise that may
+                          // decode
+
+struct Capture {
+  std::vector<unsigned int> widths; // MARK, SPACE, ..., MARK, microseconds
+  unsigned long expected;
+  bool clean; // Should always decode
+  bool floor; // Should decode at least JITTERFLOOR percent of the time
+  unsigned long gap; // Quiet before the capture, microseconds
+  std::string kind; // What it is, for the results
+};
+
+IRrecv         irrecv(IRPIN);
+decode_results results;
+
+// Change the pin to level after width microseconds
+void edge(const uint8_t level, const unsigned long width)
+{
+  hostMicros += width;
+  hostLevel = level;
+  irRecvEdge();
+}
+
+// Replays capture, and returns what decode() made of it, NOTHING if it
+// found nothing.  Anything more than one code is counted in extra.
+unsigned long replay(const Capture & capture, uint32_t & extra)
+{
+  const std::vector<unsigned int> & widths = capture.widths;
+  edge(MARK, capture.gap - ENDGAP);
+  for (size_t i = 0; i < widths.size(); i++) {
+    edge((i & 1) ? MARK : SPACE, widths[i]);
+  }
+  // The capture ends with a gap, with no edge at the end of it
+  hostMicros += ENDGAP;
+
+  unsigned long value = NOTHING;
+  bool decoded = false;
+  while (irrecv.decode(&results)) {
+    if (decoded) {
+      extra++;
+    }
+    else {
+      value = results.value;
+      decoded = true;
+    }
+    irrecv.resume();
+  }
+  return value;
+}
+
+// Made up captures ----------------------------------------------------
+
+std::mt19937 shuffle(7);
+
+void addBits(std::vector<unsigned int> & widths, const unsigned long data,
+             const uint8_t bits, const unsigned int mark,
+             const unsigned int oneSpace, const unsigned int zeroSpace)
+{
+  for (int8_t i = bits - 1; i >= 0; i--) {
+    widths.push_back(mark);
+    widths.push_back(((data >> i) & 1) ? oneSpace : zeroSpace);
+  }
+}
+
+std::vector<unsigned int> necCode(const unsigned long code)
+{
+  std::vector<unsigned int> widths;
+  widths.push_back(NEC_HDR_MARK);
+  widths.push_back(NEC_HDR_SPACE);
+  addBits(widths, code, NEC_BITS, NEC_BIT_MARK, NEC_ONE_SPACE, NEC_ZERO_SPACE);
+  widths.push_back(NEC_BIT_MARK);
+  return widths;
+}
+
+std::vector<unsigned int> necRepeat()
+{
+  std::vector<unsigned int> widths;
+  widths.push_back(NEC_HDR_MARK);
+  widths.push_back(NEC_RPT_SPACE);
+  widths.push_back(NEC_BIT_MARK);
+  return widths;
+}
+
+// Sony sends the bit in the MARK, every SPACE is the same
+std::vector<unsigned int> sonyCode(const unsigned long code)
+{
+  std::vector<unsigned int> widths;
+  widths.push_back(SONY_HDR_MARK);
+  for (int8_t i = SONY_BITS - 1; i >= 0; i--) {
+    widths.push_back(SONY_HDR_SPACE);
+    widths.push_back(((code >> i) & 1) ? SONY_ONE_MARK : SONY_ZERO_MARK);
+  }
+  return widths;
+}
+
+// RC6 mode 6 with 32 bits, as the RC65X sends: a leader, start bit, mode
+// bits, a double length trailer bit, then the data.  A 1 is MARK then
+// SPACE, a 0 SPACE then MARK, each half RC6_T long.  decode() has no RC6
+// decoder and takes these with the hash.
+#define RC6_T 444
+void addRc6Bit(std::vector<uint8_t> & halves, const uint8_t bit,
+               const uint8_t length = 1)
+{
+  for (uint8_t i = 0; i < 2*length; i++) {
+    halves.push_back(((i < length) == (bit == 1)) ? MARK : SPACE);
+  }
+}
+
+std::vector<unsigned int> rc6Code(const unsigned long code)
+{
+  std::vector<uint8_t> halves; // Level of each RC6_T
+  halves.insert(halves.end(), 6, MARK);
+  halves.insert(halves.end(), 2, SPACE);
+  addRc6Bit(halves, 1); // Start bit
+  addRc6Bit(halves, 1); // Mode 6
+  addRc6Bit(halves, 1);
+  addRc6Bit(halves, 0);
+  addRc6Bit(halves, 0, 2); // Trailer
+  for (int8_t i = 32 - 1; i >= 0; i--) {
+    addRc6Bit(halves, (code >> i) & 1);
+  }
+  // Runs of one level make the widths, and the last SPACE is the gap
+  std::vector<unsigned int> widths;
+  for (size_t i = 0; i < halves.size(); i++) {
+    if (i == 0 || halves[i] != halves[i - 1]) {
+      widths.push_back(0);
+    }
+    widths.back() += RC6_T;
+  }
+  if (halves.back() == SPACE) {
+    widths.pop_back();
+  }
+  return widths;
+}
+
+// As a receiver outdoors sees it: marks MARK_EXCESS long, spaces as much
+// short, and every width off by up to percent either way
+std::vector<unsigned int> jitter(const std::vector<unsigned int> & clean,
+                                 const uint8_t percent)
+{
+  std::uniform_int_distribution<int> off(-percent, percent);
+  std::vector<unsigned int> widths;
+  for (size_t i = 0; i < clean.size(); i++) {
+    const int excess = (i & 1) ? -MARK_EXCESS : MARK_EXCESS;
+    const int width  = clean[i] + excess + int(clean[i])*off(shuffle)/100;
+    widths.push_back(width > USECPERTICK ? width : USECPERTICK);
+  }
+  return widths;
+}
+
+// The start of a burst, as when the sender moves out of sight
+std::vector<unsigned int> partial(const std::vector<unsigned int> & clean)
+{
+  std::uniform_int_distribution<size_t> length(1, clean.size()/2);
+  std::vector<unsigned int> widths(clean.begin(),
+                                   clean.begin() + 2*length(shuffle) - 1);
+  return widths;
+}
+
+// Flicker, e.g. sunlight through leaves or a lamp
+std::vector<unsigned int> noise()
+{
+  std::uniform_int_distribution<int> edges(1, 20);
+  std::uniform_int_distribution<unsigned int> mark(50, 600);
+  std::uniform_int_distribution<unsigned int> space(100, 3000);
+  std::vector<unsigned int> widths;
+  const int n = 2*edges(shuffle) - 1;
+  for (int i = 0; i < n; i++) {
+    widths.push_back((i & 1) ? space(shuffle) : mark(shuffle));
+  }
+  return widths;
+}
+
+void add(std::vector<Capture> & captures, const std::string & kind,
+         const std::vector<unsigned int> & widths,
+         const unsigned long expected, const bool clean = false,
+         const bool floor = false, const unsigned long gap = REPLAYGAP)
+{
+  Capture capture = {widths, expected, clean, floor, gap, kind};
+  captures.push_back(capture);
+}
+
+std::vector<Capture> madeUpCaptures()
+{
+  std::vector<Capture> captures;
+  const unsigned long necCodes[] = {0x20DF10EF, 0x00FF30CF, 0x807F807F};
+  const unsigned long sonyCodes[] = {
+    RM_YD065_KEY0, RM_YD065_KEY1, RM_YD065_KEY8, RM_YD065_KEYUP,
+    RM_YD065_KEYDOWN, RM_YD065_KEYVOLUMEUP, RM_YD065_KEYVOLUMEDOWN};
+  const unsigned long rc6Codes[] = {0x800F0401, 0x800F841E, 0x800F0422};
+  std::vector<std::vector<unsigned int> > bursts;
+  std::vector<unsigned long> sent;
+  std::vector<std::string> kinds;
+  for (size_t i = 0; i < sizeof(necCodes)/sizeof(necCodes[0]); i++) {
+    bursts.push_back(necCode(necCodes[i]));
+    sent.push_back(necCodes[i]);
+    kinds.push_back("NEC");
+  }
+  bursts.push_back(necRepeat());
+  sent.push_back(REPEAT);
+  kinds.push_back("NEC repeat");
+  for (size_t i = 0; i < sizeof(sonyCodes)/sizeof(sonyCodes[0]); i++) {
+    bursts.push_back(sonyCode(sonyCodes[i]));
+    sent.push_back(sonyCodes[i]);
+    kinds.push_back("Sony");
+  }
+  for (size_t i = 0; i < sizeof(rc6Codes)/sizeof(rc6Codes[0]); i++) {
+    bursts.push_back(rc6Code(rc6Codes[i]));
+    sent.push_back(ANYCODE);
+    kinds.push_back("RC6");
+  }
+
+  for (size_t i = 0; i < bursts.size(); i++) {
+    const std::string & kind = kinds[i];
+    add(captures, kind + " clean", jitter(bursts[i], 0), sent[i], true);
+    for (uint8_t j = 0; j < 20; j++) {
+      add(captures, kind + " 10% jitter", jitter(bursts[i], 10), sent[i],
+          false, true);
+      add(captures, kind + " 20% jitter", jitter(bursts[i], 20), sent[i]);
+      // The hash cannot tell the start of an RC6 code from a whole one
+      if (sent[i] != ANYCODE) {
+        add(captures, kind + " partial", partial(jitter(bursts[i], 10)),
+            NOTHING);
+      }
+    }
+  }
+  // A Sony remote sends a held key's code every 45 ms, which decodes as a
+  // repeat
+  for (size_t i = 0; i < sizeof(sonyCodes)/sizeof(sonyCodes[0]); i++) {
+    add(captures, "Sony repeat clean", jitter(sonyCode(sonyCodes[i]), 0),
+        REPEAT, true, false, SONYREPEATGAP);
+  }
+  for (uint16_t i = 0; i < 200; i++) {
+    add(captures, "Noise", noise(), NOTHING);
+  }
+  return captures;
+}
+
+// Captures from files -------------------------------------------------
+
+bool readCaptures(const char * name, std::vector<Capture> & captures)
+{
+  std::ifstream file(name);
+  if (!file) {
+    std::cerr << "Cannot read " << name << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream words(line);
+    std::string expected;
+    if (!(words >> expected) || expected[0] == '#') {
+      continue;
+    }
+    Capture capture;
+    capture.expected = (expected == "-") ? NOTHING
+      : (expected == "REPEAT") ? REPEAT
+      : std::stoul(expected, NULL, 16);
+    capture.clean = false;
+    capture.floor = false;
+    capture.gap   = REPLAYGAP;
+    capture.kind  = name;
+    long width;
+    while (words >> width) {
+      capture.widths.push_back(width < 0 ? -width : width);
+    }
+    captures.push_back(capture);
+  }
+  return true;
+}
+
+// Results -------------------------------------------------------------
+
+bool asExpected(const unsigned long value, const unsigned long expected)
+{
+  return (expected == ANYCODE) ? (value != NOTHING && value != REPEAT)
+    : (value == expected);
+}
+
+// How captures of one kind fared, right meaning decoded as expected
+struct Tally {
+  uint32_t right;
+  uint32_t of;
+  bool     floor; // Needs JITTERFLOOR percent right
+};
+
+void printRate(const std::string & name, const uint32_t count,
+               const uint32_t of)
+{
+  std::cout << std::left  << std::setw(40) << name
+            << std::right << std::setw(10) << std::fixed
+            << std::setprecision(1) << (of ? 100.0*count/of : 0.0)
+            << " % (" << count << "/" << of << ")" << std::endl;
+}
+
+void printResult(const char * name, const double nsPerCall)
+{
+  std::cout << std::left  << std::setw(40) << name
+            << std::right << std::setw(10) << std::fixed
+            << std::setprecision(2) << nsPerCall << " ns/call" << std::endl;
+}
+
+int main(int argc, char * argv[])
+{
+  irrecv.enableIRIn();
+
+  std::vector<Capture> captures;
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      if (!readCaptures(argv[i], captures)) {
+        return 1;
+      }
+    }
+  }
+  else {
+    captures = madeUpCaptures();
+  }
+
+  uint32_t codes = 0, decoded = 0, wrong = 0, cleanFailed = 0;
+  uint32_t others = 0, falseKeys = 0, extra = 0;
+  std::vector<std::string> kinds;
+  std::map<std::string, Tally> tallies;
+  for (size_t i = 0; i < captures.size(); i++) {
+    const Capture & capture = captures[i];
+    const unsigned long value = replay(capture, extra);
+    if (tallies.find(capture.kind) == tallies.end()) {
+      kinds.push_back(capture.kind);
+      tallies[capture.kind] = Tally();
+    }
+    Tally & tally = tallies[capture.kind];
+    tally.of++;
+    tally.floor = capture.floor;
+    const bool right = asExpected(value, capture.expected);
+    if (right) {
+      tally.right++;
+    }
+    if (capture.expected != NOTHING) {
+      codes++;
+      if (right) {
+        decoded++;
+      }
+      else {
+        if (value != NOTHING) {
+          wrong++;
+        }
+        if (capture.clean) {
+          cleanFailed++;
+          std::cout << "Clean capture " << i << " decoded to 0x" << std::hex
+                    << value << ", not 0x" << capture.expected << std::dec
+                    << std::endl;
+        }
+      }
+    }
+    else {
+      others++;
+      if (value != NOTHING) {
+        falseKeys++;
+      }
+    }
+  }
+
+  // Whole replays, edges and decode(), over and over for the timing
+  const uint32_t rounds = 200;
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (uint32_t round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < captures.size(); i++) {
+      replay(captures[i], extra);
+    }
+  }
+  const std::chrono::steady_clock::time_point stop =
+    std::chrono::steady_clock::now();
+  const double ns = std::chrono::duration<double, std::nano>(stop - start)
+    .count()/(double(rounds)*captures.size());
+
+#ifdef IR_STREAMING
+  std::cout << "IR_STREAMING decoder" << std::endl;
+#else
+  std::cout << "Raw buffer decoder" << std::endl;
+#endif
+  uint32_t belowFloor = 0;
+  for (size_t i = 0; i < kinds.size(); i++) {
+    const Tally & tally = tallies[kinds[i]];
+    printRate(kinds[i] + " as expected", tally.right, tally.of);
+    if (tally.floor && 100*tally.right < JITTERFLOOR*tally.of) {
+      belowFloor++;
+      std::cout << kinds[i] << " is below " << JITTERFLOOR << " %"
+                << std::endl;
+    }
+  }
+  printRate("Codes decoded", decoded, codes);
+  printRate("Codes decoded to another value", wrong, codes);
+  printRate("Partial bursts and noise as keys", falseKeys, others);
+  std::cout << std::left << std::setw(40) << "More than one code per capture"
+            << std::right << std::setw(10) << extra/(rounds + 1) << std::endl;
+  printResult("IRrecv edges and decode()", ns);
+
+  const bool tooManyFalseKeys = 100*falseKeys > FALSEKEYCEILING*others;
+  if (wrong) {
+    std::cout << "Codes decoded to another value" << std::endl;
+  }
+  if (tooManyFalseKeys) {
+    std::cout << "Partial bursts and noise are above " << FALSEKEYCEILING
+              << " %" << std::endl;
+  }
+  return (cleanFailed || belowFloor || wrong || tooManyFalseKeys) ? 1 : 0;
+}
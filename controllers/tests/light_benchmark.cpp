@@ -0,0 +1,100 @@
+// Host side timing of the light curve calculations and light updates.
+// Numbers are for whatever machine runs "make bench", not the ATmega328,
+// but the ratios between the paths compared are what we are after.
+#include "lucky7.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+// Keep the compiler from optimizing the calls away
+volatile uint8_t sink;
+
+template <typename Function>
+double nanosecondsPerCall(Function function, const uint32_t calls)
+{
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < calls; i++) {
+    sink = function(i);
+  }
+  const std::chrono::steady_clock::time_point stop =
+    std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(stop - start).count()/calls;
+}
+
+void printResult(const char * name, const double nsPerCall)
+{
+  std::cout << std::left  << std::setw(40) << name
+            << std::right << std::setw(10) << std::fixed
+            << std::setprecision(2) << nsPerCall << " ns/call" << std::endl;
+}
+
+uint8_t decayFloat(const uint32_t i) {
+  return DecayLight::decayLevelFloat(ON, i % 1110, 175);
+}
+
+uint8_t decayFixed(const uint32_t i) {
+  return DecayLight::decayLevelFixed(ON, i % 1110, 175);
+}
+
+uint8_t pulseFloat(const uint32_t i) {
+  return RotatingLight::pulseLevelFloat(20, ON, i % 736, 736);
+}
+
+const uint32_t pulsePhaseStep = RotatingLight::pulsePhaseStep(736);
+uint8_t pulseFixed(const uint32_t i) {
+  return RotatingLight::pulseLevelFixed(20, ON, i % 736, pulsePhaseStep);
+}
+
+// Whole update()s, a 10 ms tick apart, of the B-29 position light and the
+// B-52c collision light
+const DecayLight::Interval positionIntervals[1] PROGMEM = {
+  {LUCKY7_DURATION(110), LUCKY7_DURATION(1110), LUCKY7_DURATION(175), ON}};
+uint8_t decayVariable, rotatingVariable;
+DecayLight    decayLight;
+RotatingLight rotatingLight;
+
+uint8_t decayUpdate(const uint32_t i) {
+  decayLight.update(i*10);
+  return decayVariable;
+}
+
+uint8_t rotatingUpdate(const uint32_t i) {
+  rotatingLight.update(i*10);
+  return rotatingVariable;
+}
+
+// The same lights, updated only when due, as the sketches do
+uint8_t decayUpdateIfDue(const uint32_t i) {
+  updateIfDue(decayLight, i*10);
+  return decayVariable;
+}
+
+uint8_t rotatingUpdateIfDue(const uint32_t i) {
+  updateIfDue(rotatingLight, i*10);
+  return rotatingVariable;
+}
+
+int main()
+{
+  const uint32_t calls = 10000000;
+
+  printResult("DecayLight::decayLevelFloat", nanosecondsPerCall(decayFloat, calls));
+  printResult("DecayLight::decayLevelFixed", nanosecondsPerCall(decayFixed, calls));
+  printResult("RotatingLight::pulseLevelFloat", nanosecondsPerCall(pulseFloat, calls));
+  printResult("RotatingLight::pulseLevelFixed", nanosecondsPerCall(pulseFixed, calls));
+
+  decayLight.setup(decayVariable, ON, 1, positionIntervals);
+  rotatingLight.setup(rotatingVariable, ON, 250, 0, 736, 20, ON);
+
+  printResult("DecayLight::update", nanosecondsPerCall(decayUpdate, calls));
+  printResult("RotatingLight::update", nanosecondsPerCall(rotatingUpdate, calls));
+
+  decayLight.setup(decayVariable, ON, 1, positionIntervals);
+  rotatingLight.setup(rotatingVariable, ON, 250, 0, 736, 20, ON);
+
+  printResult("updateIfDue(DecayLight)", nanosecondsPerCall(decayUpdateIfDue, calls));
+  printResult("updateIfDue(RotatingLight)", nanosecondsPerCall(rotatingUpdateIfDue, calls));
+
+  return 0;
+}
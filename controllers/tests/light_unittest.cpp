@@ -1,6 +1,7 @@
 #include "lucky7.h"
 #include <gtest/gtest.h>
 #include <algorithm>    // std::max
+#include <type_traits>  // std::is_polymorphic
 
 
 using std::setfill;
@@ -329,21 +330,19 @@ TEST(DecayLight, Constructor)
   uint32_t decayLengths  [3] = { 500, 1000, 250};
   uint8_t  maxLightLevels[3] = { 100,  150, 200};
   uint32_t tauInMillisec [3] = { 250,  500, 125};
-  const uint8_t  numIntervals = sizeof(maxLightLevels)/sizeof(uint8_t);
+  const DecayLight::Interval intervals[3] = {
+    {LUCKY7_DURATION(1000), LUCKY7_DURATION( 500), LUCKY7_DURATION(250), 100},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(1000), LUCKY7_DURATION(500), 150},
+    {LUCKY7_DURATION( 500), LUCKY7_DURATION( 250), LUCKY7_DURATION(125), 200}};
+  const uint8_t  numIntervals = sizeof(intervals)/sizeof(DecayLight::Interval);
   assert (numIntervals == 3);
   
   DecayLight light1;
-  EXPECT_EQ(NULL, light1.onLength     );
-  EXPECT_EQ(NULL, light1.decayLength  );
-  EXPECT_EQ(NULL, light1.maxLightLevel);
-  EXPECT_EQ(NULL, light1.tau          );
+  EXPECT_EQ(NULL, light1.intervals);
   light1.setup(lightVariable,
                onLightLevelValue,
                numIntervals,
-               onLengths,
-               decayLengths,
-               maxLightLevels,
-               tauInMillisec);
+               intervals);
 
   
   EXPECT_EQ(OFF  , *light1.p_lightLevel);
@@ -353,11 +352,12 @@ TEST(DecayLight, Constructor)
   
   EXPECT_EQ(true , light1.decaying);
   EXPECT_EQ(0    , light1.changeTime);
+  EXPECT_EQ(intervals, light1.intervals);
   for (uint8_t i = 0; i < numIntervals; i++) {
-    EXPECT_EQ(onLengths[i]     , light1.onLength[i]); 
-    EXPECT_EQ(decayLengths[i]  , light1.decayLength[i]);
-    EXPECT_EQ(maxLightLevels[i], light1.maxLightLevel[i]);
-    EXPECT_EQ(tauInMillisec[i] , light1.tau[i]);
+    EXPECT_EQ(onLengths[i]     , light1.getOnLength(i)); 
+    EXPECT_EQ(decayLengths[i]  , light1.getDecayLength(i));
+    EXPECT_EQ(maxLightLevels[i], light1.getMaxLightLevel(i));
+    EXPECT_EQ(tauInMillisec[i] , light1.getTau(i));
   }
 }
 
@@ -415,11 +415,12 @@ TEST(DecayLight, Update)
 
   //                                   ---------------- Starts here
   //                                  \/
-  uint32_t onLengths     [4] = { 500, 1000, 2000, 2000};
-  uint32_t decayLengths  [4] = {1000, 2000, 4000, 4000};
-  uint8_t  maxLightLevels[4] = { 100,  150,  200,  100};
-  uint32_t tauInMillisec [4] = { 250,  500, 1000,    0};
-  const uint8_t  numIntervals = sizeof(maxLightLevels)/sizeof(uint8_t);
+  const DecayLight::Interval intervalValues[4] = {
+    {LUCKY7_DURATION( 500), LUCKY7_DURATION(1000), LUCKY7_DURATION( 250), 100},
+    {LUCKY7_DURATION(1000), LUCKY7_DURATION(2000), LUCKY7_DURATION( 500), 150},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(4000), LUCKY7_DURATION(1000), 200},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(4000), 0,                     100}};
+  const uint8_t  numIntervals = sizeof(intervalValues)/sizeof(DecayLight::Interval);
   assert (numIntervals == 4);
 
   
@@ -440,10 +441,7 @@ TEST(DecayLight, Update)
   light1.setup(lightVariable,
                onLightLevelValue,
                numIntervals,
-               onLengths,
-               decayLengths,
-               maxLightLevels,
-               tauInMillisec);
+               intervalValues);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
   
@@ -511,11 +509,10 @@ TEST(DecayLight, Update2)
 
   //                                    ---------------- Starts here
   //                                   \/
-  uint32_t onLengths     [2] = {  50,   50};
-  uint32_t decayLengths  [2] = {1000, 4000};
-  uint8_t  maxLightLevels[2] = {ON, ON};
-  uint32_t tauInMillisec [2] = {0,0};
-  const uint8_t  numIntervals = sizeof(maxLightLevels)/sizeof(uint8_t);
+  const DecayLight::Interval intervalValues[2] = {
+    {LUCKY7_DURATION(50), LUCKY7_DURATION(1000), 0, ON},
+    {LUCKY7_DURATION(50), LUCKY7_DURATION(4000), 0, ON}};
+  const uint8_t  numIntervals = sizeof(intervalValues)/sizeof(DecayLight::Interval);
   assert (numIntervals == 2);
 
   //                             On       Off          On         Off
@@ -530,10 +527,7 @@ TEST(DecayLight, Update2)
   light1.setup(lightVariable,
                onLightLevelValue,
                numIntervals,
-               onLengths,
-               decayLengths,
-               maxLightLevels,
-               tauInMillisec);
+               intervalValues);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
   
@@ -559,7 +553,7 @@ TEST(DecayLight, Update2)
   releaseArduinoMock();
 }
 
-TEST(DecayLight, UpdateWithTauNULL)
+TEST(DecayLight, UpdateWithTauZero)
 {
   const uint8_t intervals = 3*24;
   
@@ -571,11 +565,12 @@ TEST(DecayLight, UpdateWithTauNULL)
   uint8_t lightVariable;
 
 
-  uint32_t onLengths     [4] = { 500, 1000, 2000, 2000};
-  uint32_t decayLengths  [4] = {1000, 2000, 4000, 4000};
-  uint8_t  maxLightLevels[4] = { 100,  150,  200,  100};
-  uint32_t * tauInMillisec = NULL;
-  const uint8_t  numIntervals = sizeof(maxLightLevels)/sizeof(uint8_t);
+  const DecayLight::Interval intervalValues[4] = {
+    {LUCKY7_DURATION( 500), LUCKY7_DURATION(1000), 0, 100},
+    {LUCKY7_DURATION(1000), LUCKY7_DURATION(2000), 0, 150},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(4000), 0, 200},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(4000), 0, 100}};
+  const uint8_t  numIntervals = sizeof(intervalValues)/sizeof(DecayLight::Interval);
   assert (numIntervals == 4);
 
   
@@ -583,10 +578,7 @@ TEST(DecayLight, UpdateWithTauNULL)
   light1.setup(lightVariable,
                onLightLevelValue,
                numIntervals,
-               onLengths,
-               decayLengths,
-               maxLightLevels,
-               tauInMillisec);
+               intervalValues);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
 
@@ -723,11 +715,12 @@ TEST(DecayLight, UpdateCalledInfrequently) {
 
   //                                   ---------------- Starts here
   //                                  \/
-  uint32_t onLengths     [4] = { 500, 1000, 2000, 2000};
-  uint32_t decayLengths  [4] = {1000, 2000, 4000, 4000};
-  uint8_t  maxLightLevels[4] = { 100,  150,  200,  100};
-  uint32_t tauInMillisec [4] = { 250,  500, 1000,    0};
-  const uint8_t  numIntervals = sizeof(maxLightLevels)/sizeof(uint8_t);
+  const DecayLight::Interval intervalValues[4] = {
+    {LUCKY7_DURATION( 500), LUCKY7_DURATION(1000), LUCKY7_DURATION( 250), 100},
+    {LUCKY7_DURATION(1000), LUCKY7_DURATION(2000), LUCKY7_DURATION( 500), 150},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(4000), LUCKY7_DURATION(1000), 200},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(4000), 0,                     100}};
+  const uint8_t  numIntervals = sizeof(intervalValues)/sizeof(DecayLight::Interval);
   assert (numIntervals == 4);
 
   //                                On   Decay  Decay  Decay Decay Decay
@@ -749,10 +742,7 @@ TEST(DecayLight, UpdateCalledInfrequently) {
   light1.setup(lightVariable,
                onLightLevelValue,
                numIntervals,
-               onLengths,
-               decayLengths,
-               maxLightLevels,
-               tauInMillisec);
+               intervalValues);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
   
@@ -788,6 +778,128 @@ TEST(DecayLight, UpdateCalledInfrequently) {
   releaseArduinoMock();
 }
 
+TEST(DecayLight, DecayLevelFixedMatchesFloat)
+{
+  // Taus used by the sketches plus some odd and very long ones
+  const uint32_t taus[8]           = {1, 7, 100, 175, 250, 1000, 4321, 600000};
+  const uint8_t  maxLightLevels[4] = {ON, 199, 100, 1};
+
+  for (uint8_t t = 0; t < sizeof(taus)/sizeof(uint32_t); t++) {
+    const uint32_t tau  = taus[t];
+    const uint32_t step = tau/100 + 1;
+    for (uint8_t m = 0; m < sizeof(maxLightLevels)/sizeof(uint8_t); m++) {
+      const uint8_t maxLightLevel = maxLightLevels[m];
+      for (uint32_t time = 0; time <= 14*tau; time += step) {
+        const int fixed = DecayLight::decayLevelFixed(maxLightLevel, time, tau);
+        const int flt   = DecayLight::decayLevelFloat(maxLightLevel, time, tau);
+        EXPECT_LE(abs(fixed - flt), 1)
+          << "tau, maxLightLevel, time = " << tau << ", "
+          << int(maxLightLevel) << ", " << time << std::endl;
+      }
+    }
+  }
+
+  EXPECT_EQ(ON , DecayLight::decayLevelFixed(ON, 0, 100));
+  EXPECT_EQ(OFF, DecayLight::decayLevelFixed(ON, 100, 0));
+  EXPECT_EQ(OFF, DecayLight::decayLevelFixed(ON, 0xFFFFFFFF, 100));
+}
+
+TEST(DecayLight, Intervals)
+{
+  // Lengths used by the sketches pack without loss.  Lengths that do
+  // not, like 16385 or 43200000, fail to compile.
+  const uint32_t lengths[10] = {0, 50, 110, 1110, 16383, 61500, 91000,
+                                300000, 3600000, 16382000};
+  const uint16_t packed [10] = {
+    LUCKY7_DURATION(0), LUCKY7_DURATION(50), LUCKY7_DURATION(110),
+    LUCKY7_DURATION(1110), LUCKY7_DURATION(16383), LUCKY7_DURATION(61500),
+    LUCKY7_DURATION(91000), LUCKY7_DURATION(300000), LUCKY7_DURATION(3600000),
+    LUCKY7_DURATION(16382000)};
+  for (uint8_t i = 0; i < sizeof(lengths)/sizeof(uint32_t); i++) {
+    EXPECT_EQ(lengths[i], DecayLight::duration(packed[i]))
+      << "length = " << lengths[i] << std::endl;
+    EXPECT_EQ(packed[i], lucky7Duration(lengths[i]))
+      << "length = " << lengths[i] << std::endl;
+  }
+  EXPECT_EQ(1000, lucky7DurationUnit(16382000));
+  EXPECT_EQ(10  , lucky7DurationUnit(61500));
+
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, millis())
+    .Times(0);
+
+  const DecayLight::Interval dayIntervals[2] = {
+    {LUCKY7_DURATION(110), LUCKY7_DURATION(1110), LUCKY7_DURATION(175), ON},
+    {LUCKY7_DURATION( 50), LUCKY7_DURATION(1500), 0, maxLightLevelValue}};
+  const DecayLight::Interval nightIntervals[2] = {
+    {LUCKY7_DURATION(110), LUCKY7_DURATION(1110), LUCKY7_DURATION(175), 100},
+    {LUCKY7_DURATION( 50), LUCKY7_DURATION(1500), 0, 50}};
+
+  uint8_t tableVariable;
+  DecayLight tableLight;
+  tableLight.setup(tableVariable, onLightLevelValue, 2, dayIntervals);
+
+  // The first update starts on the second interval, 50 + 1500 ms, then
+  // the first, 110 + 1110 ms
+  for (uint32_t timeMS = 0; timeMS < 10000; timeMS += 5) {
+    tableLight.update(timeMS);
+    const uint32_t cycleMS = timeMS % 2770;
+    const uint8_t expected =
+      cycleMS <   50 ? maxLightLevelValue :
+      cycleMS < 1550 ? OFF :
+      cycleMS < 1660 ? ON  : DecayLight::decayLevel(ON, cycleMS - 1660, 175);
+    EXPECT_EQ(expected, tableLight()) << "timeMS = " << timeMS << std::endl;
+  }
+
+  // Switching tables keeps the timing, only the levels change
+  const uint32_t changeTime = tableLight.changeTime;
+  tableLight.setIntervals(nightIntervals);
+  EXPECT_EQ(changeTime, tableLight.changeTime);
+  EXPECT_EQ(100, tableLight.getMaxLightLevel(0));
+  EXPECT_EQ(50 , tableLight.getMaxLightLevel(1));
+  EXPECT_EQ(50 , tableLight.getOnLength(1));
+
+  releaseArduinoMock();
+}
+
+TEST(RotatingLight, PulseLevelFixedMatchesFloat)
+{
+  // Pulse lengths used by the sketches plus some odd ones
+  const uint32_t pulseLengths[6]   = {1, 3, 100, 736, 1000, 60000};
+  const uint8_t  minLightLevels[3] = {OFF, 20, 100};
+  const uint8_t  maxLightLevels[2] = {ON, 199};
+
+  for (uint8_t p = 0; p < sizeof(pulseLengths)/sizeof(uint32_t); p++) {
+    const uint32_t pulseLength = pulseLengths[p];
+    const uint32_t phaseStep   = RotatingLight::pulsePhaseStep(pulseLength);
+    const uint32_t step        = pulseLength/500 + 1;
+    for (uint8_t mn = 0; mn < sizeof(minLightLevels)/sizeof(uint8_t); mn++) {
+      for (uint8_t mx = 0; mx < sizeof(maxLightLevels)/sizeof(uint8_t); mx++) {
+        const uint8_t minLightLevel = minLightLevels[mn];
+        const uint8_t maxLightLevel = maxLightLevels[mx];
+        // A full period of |sin| is two pulses
+        for (uint32_t time = 0; time <= 2*pulseLength; time += step) {
+          const int fixed = RotatingLight::pulseLevelFixed(minLightLevel,
+                                                           maxLightLevel,
+                                                           time, phaseStep);
+          const int flt   = RotatingLight::pulseLevelFloat(minLightLevel,
+                                                           maxLightLevel,
+                                                           time, pulseLength);
+          EXPECT_LE(abs(fixed - flt), 1)
+            << "pulseLength, minLightLevel, maxLightLevel, time = "
+            << pulseLength << ", " << int(minLightLevel) << ", "
+            << int(maxLightLevel) << ", " << time << std::endl;
+        }
+      }
+    }
+  }
+
+  const uint32_t phaseStep = RotatingLight::pulsePhaseStep(736);
+  EXPECT_EQ(20, RotatingLight::pulseLevelFixed(20, ON, 0, phaseStep));
+  EXPECT_EQ(ON, RotatingLight::pulseLevelFixed(20, ON, 368, phaseStep));
+  EXPECT_EQ(20, RotatingLight::pulseLevelFixed(20, ON, 736, phaseStep));
+}
+
 
 // TEST(RotatingLight, Constructor)
 // {
@@ -1270,16 +1382,18 @@ TEST(FlashingLight, Constructor)
   uint32_t onLengths     [3] = {1000, 2000, 500};
   uint32_t decayLengths  [3] = { 500, 1000, 250};
   uint8_t  maxLightLevels[3] = { 100,  150, 200};
-  const uint8_t  numIntervals = sizeof(maxLightLevels)/sizeof(uint8_t);
+  const DecayLight::Interval intervals[3] = {
+    {LUCKY7_DURATION(1000), LUCKY7_DURATION( 500), 0, 100},
+    {LUCKY7_DURATION(2000), LUCKY7_DURATION(1000), 0, 150},
+    {LUCKY7_DURATION( 500), LUCKY7_DURATION( 250), 0, 200}};
+  const uint8_t  numIntervals = sizeof(intervals)/sizeof(DecayLight::Interval);
   assert (numIntervals == 3);
   
   FlashingLight light1;
   light1.setup(lightVariable,
                onLightLevelValue,
                numIntervals,
-               onLengths,
-               decayLengths,
-               maxLightLevels);
+               intervals);
   
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
   EXPECT_EQ(OFF  , *light1.p_lightLevel);
@@ -1289,9 +1403,10 @@ TEST(FlashingLight, Constructor)
   EXPECT_EQ(true , light1.decaying);
   EXPECT_EQ(0    , light1.changeTime);
   for (uint8_t i = 0; i < numIntervals; i++) {
-    EXPECT_EQ(onLengths[i]     , light1.onLength[i]); 
-    EXPECT_EQ(decayLengths[i]  , light1.decayLength[i]);
-    EXPECT_EQ(maxLightLevels[i], light1.maxLightLevel[i]);
+    EXPECT_EQ(onLengths[i]     , light1.getOnLength(i)); 
+    EXPECT_EQ(decayLengths[i]  , light1.getDecayLength(i));
+    EXPECT_EQ(maxLightLevels[i], light1.getMaxLightLevel(i));
+    EXPECT_EQ(0                , light1.getTau(i));
   }
 }
 
@@ -1299,12 +1414,13 @@ TEST(BlinkingLight, Constructor)
 {
   uint8_t lightVariable;
 
+  const DecayLight::Interval interval[1] = {
+    {LUCKY7_DURATION(1000), LUCKY7_DURATION(10), 0, maxLightLevelValue}};
+
   BlinkingLight light1;
   light1.setup(lightVariable,
                onLightLevelValue,
-               1000, // onLengthValue
-               10  , // offLengthValue
-               maxLightLevelValue);
+               interval);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
   EXPECT_EQ(OFF, *light1.p_lightLevel);
@@ -1312,9 +1428,10 @@ TEST(BlinkingLight, Constructor)
   EXPECT_EQ(Light::LIGHT_FLASHING, light1.getLightMode());
 
   EXPECT_EQ(0,    light1.changeTime);
-  EXPECT_EQ(1000, light1.onLength[0]);
-  EXPECT_EQ(10  , light1.decayLength[0]);
-  EXPECT_EQ(maxLightLevelValue , light1.maxLightLevel[0]);
+  EXPECT_EQ(1000, light1.getOnLength(0));
+  EXPECT_EQ(10  , light1.getDecayLength(0));
+  EXPECT_EQ(0   , light1.getTau(0));
+  EXPECT_EQ(maxLightLevelValue , light1.getMaxLightLevel(0));
 }
 
 TEST(BlinkingLight, Update)
@@ -1329,16 +1446,13 @@ TEST(BlinkingLight, Update)
   uint8_t lightVariable;
 
 
-  uint32_t onLength      =  500;
-  uint32_t offLength     = 1000; 
-  uint8_t  maxLightLevel =  100; 
+  const DecayLight::Interval interval[1] = {
+    {LUCKY7_DURATION(500), LUCKY7_DURATION(1000), 0, 100}};
   
   BlinkingLight light1;
   light1.setup(lightVariable,
                onLightLevelValue,
-               onLength,
-               offLength,
-               maxLightLevel);
+               interval);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
 
@@ -1407,7 +1521,7 @@ TEST(FastBlinkingLight, Constructor)
   uint8_t lightVariable;
 
   FastBlinkingLight light1;
-  light1.setup(lightVariable, onLightLevelValue, maxLightLevelValue);
+  light1.setup(lightVariable, onLightLevelValue);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
   EXPECT_EQ(OFF, *light1.p_lightLevel);
@@ -1415,9 +1529,9 @@ TEST(FastBlinkingLight, Constructor)
   EXPECT_EQ(Light::LIGHT_FLASHING, light1.getLightMode());
 
   EXPECT_EQ(0,    light1.changeTime);
-  EXPECT_EQ(fastOnLengthValue , light1.onLength[0]);
-  EXPECT_EQ(fastOffLengthValue, light1.decayLength[0]);
-  EXPECT_EQ(maxLightLevelValue, light1.maxLightLevel[0]);
+  EXPECT_EQ(fastOnLengthValue , light1.getOnLength(0));
+  EXPECT_EQ(fastOffLengthValue, light1.getDecayLength(0));
+  EXPECT_EQ(ON, light1.getMaxLightLevel(0));
 }
 
 TEST(SlowBlinkingLight, Constructor)
@@ -1425,8 +1539,7 @@ TEST(SlowBlinkingLight, Constructor)
   uint8_t lightVariable;
 
   SlowBlinkingLight light1;
-  light1.setup(lightVariable, onLightLevelValue,
-               maxLightLevelValue);
+  light1.setup(lightVariable, onLightLevelValue);
 
   EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
   EXPECT_EQ(OFF, *light1.p_lightLevel);
@@ -1434,9 +1547,9 @@ TEST(SlowBlinkingLight, Constructor)
   EXPECT_EQ(Light::LIGHT_FLASHING, light1.getLightMode());
 
   EXPECT_EQ(0,    light1.changeTime);
-  EXPECT_EQ(slowOnLengthValue , light1.onLength[0]);
-  EXPECT_EQ(slowOffLengthValue, light1.decayLength[0]);
-  EXPECT_EQ(maxLightLevelValue, light1.maxLightLevel[0]);
+  EXPECT_EQ(slowOnLengthValue , light1.getOnLength(0));
+  EXPECT_EQ(slowOffLengthValue, light1.getDecayLength(0));
+  EXPECT_EQ(ON, light1.getMaxLightLevel(0));
 }
 
 TEST(FastSlowBlinkingLight, Constructor)
@@ -1445,31 +1558,23 @@ TEST(FastSlowBlinkingLight, Constructor)
 
   FastSlowBlinkingLight light1;
   EXPECT_EQ(FastSlowBlinkingLight::NOTSET , light1.getSpeed());
-  EXPECT_EQ(NULL, light1.fastLight.p_lightLevel);
-  EXPECT_EQ(NULL, light1.slowLight.p_lightLevel);
-  EXPECT_EQ(NULL, light1.p_currentLight);
+  EXPECT_EQ(NULL, light1.p_lightLevel);
   
   light1.setup(lightVariable, onLightLevelValue, maxLightLevelValue);
   
-  EXPECT_EQ(onLightLevelValue, light1.fastLight.onLightLevel);
-  EXPECT_EQ(OFF, *light1.fastLight.p_lightLevel);
-  EXPECT_EQ(OFF, lightVariable);
-  EXPECT_EQ(Light::LIGHT_FLASHING, light1.fastLight.getLightMode());
-  
-  EXPECT_EQ(onLightLevelValue, light1.slowLight.onLightLevel);
-  EXPECT_EQ(OFF, *light1.slowLight.p_lightLevel);
+  EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
+  EXPECT_EQ(maxLightLevelValue, light1.maxLightLevel);
+  EXPECT_EQ(OFF, *light1.p_lightLevel);
   EXPECT_EQ(OFF, lightVariable);
-  EXPECT_EQ(Light::LIGHT_FLASHING, light1.slowLight.getLightMode());
-  
-  EXPECT_EQ(0,    light1.fastLight.changeTime);
-  EXPECT_EQ(fastOnLengthValue , light1.fastLight.onLength[0]);
-  EXPECT_EQ(fastOffLengthValue, light1.fastLight.decayLength[0]);
-  EXPECT_EQ(maxLightLevelValue, light1.fastLight.maxLightLevel[0]);
-  
-  EXPECT_EQ(0,    light1.slowLight.changeTime);
-  EXPECT_EQ(slowOnLengthValue , light1.slowLight.onLength[0]);
-  EXPECT_EQ(slowOffLengthValue, light1.slowLight.decayLength[0]);
-  EXPECT_EQ(maxLightLevelValue, light1.slowLight.maxLightLevel[0]);
+  EXPECT_EQ(Light::LIGHT_FLASHING, light1.getLightMode());
+  EXPECT_EQ(FastSlowBlinkingLight::FAST, light1.getSpeed());
+  EXPECT_EQ(0,    light1.changeTime);
+  EXPECT_FALSE(light1.getBlinkOn());
+
+  EXPECT_EQ(fastOnLengthValue , FastSlowBlinkingLight::blinkLength(FastSlowBlinkingLight::FAST, true));
+  EXPECT_EQ(fastOffLengthValue, FastSlowBlinkingLight::blinkLength(FastSlowBlinkingLight::FAST, false));
+  EXPECT_EQ(slowOnLengthValue , FastSlowBlinkingLight::blinkLength(FastSlowBlinkingLight::SLOW, true));
+  EXPECT_EQ(slowOffLengthValue, FastSlowBlinkingLight::blinkLength(FastSlowBlinkingLight::SLOW, false));
 }
 
 TEST(FastSlowBlinkingLight, SetToFast)
@@ -1480,14 +1585,20 @@ TEST(FastSlowBlinkingLight, SetToFast)
   EXPECT_EQ(FastSlowBlinkingLight::NOTSET , light1.getSpeed());
   
   light1.setup(lightVariable, onLightLevelValue, maxLightLevelValue);
-  
+  light1.setToSlow();
   light1.setToFast();
-  
-  EXPECT_EQ(0,    light1.p_currentLight->changeTime);
-  EXPECT_EQ(fastOnLengthValue , light1.p_currentLight->onLength[0]);
-  EXPECT_EQ(fastOffLengthValue, light1.p_currentLight->decayLength[0]);
-  EXPECT_EQ(maxLightLevelValue, light1.p_currentLight->maxLightLevel[0]);
   EXPECT_EQ(FastSlowBlinkingLight::FAST , light1.getSpeed());
+  EXPECT_EQ(0,    light1.changeTime);
+
+  light1.update(0);
+  EXPECT_TRUE(light1.getBlinkOn());
+  EXPECT_EQ(maxLightLevelValue, lightVariable);
+  EXPECT_EQ(fastOnLengthValue, light1.changeTime);
+
+  light1.update(fastOnLengthValue);
+  EXPECT_FALSE(light1.getBlinkOn());
+  EXPECT_EQ(OFF, lightVariable);
+  EXPECT_EQ(fastOnLengthValue + fastOffLengthValue, light1.changeTime);
 }
 
 TEST(FastSlowBlinkingLight, SetToSlow)
@@ -1498,14 +1609,57 @@ TEST(FastSlowBlinkingLight, SetToSlow)
   EXPECT_EQ(FastSlowBlinkingLight::NOTSET , light1.getSpeed());
   
   light1.setup(lightVariable, onLightLevelValue, maxLightLevelValue);
-  
   light1.setToSlow();
-  
-  EXPECT_EQ(0,    light1.p_currentLight->changeTime);
-  EXPECT_EQ(slowOnLengthValue , light1.p_currentLight->onLength[0]);
-  EXPECT_EQ(slowOffLengthValue, light1.p_currentLight->decayLength[0]);
-  EXPECT_EQ(maxLightLevelValue, light1.p_currentLight->maxLightLevel[0]);
   EXPECT_EQ(FastSlowBlinkingLight::SLOW , light1.getSpeed());
+  EXPECT_EQ(0,    light1.changeTime);
+
+  light1.update(0);
+  EXPECT_TRUE(light1.getBlinkOn());
+  EXPECT_EQ(maxLightLevelValue, lightVariable);
+  EXPECT_EQ(slowOnLengthValue, light1.changeTime);
+
+  light1.update(slowOnLengthValue);
+  EXPECT_FALSE(light1.getBlinkOn());
+  EXPECT_EQ(OFF, lightVariable);
+  EXPECT_EQ(slowOnLengthValue + slowOffLengthValue, light1.changeTime);
+}
+
+TEST(FastSlowBlinkingLight, KeepsPhase)
+{
+  uint8_t lightVariable;
+
+  FastSlowBlinkingLight light1;
+  light1.setup(lightVariable, onLightLevelValue, maxLightLevelValue);
+  light1.setToSlow();
+
+  // On part of a slow blink started at 1000
+  light1.update(1000);
+  EXPECT_EQ(1000 + slowOnLengthValue, light1.changeTime);
+
+  // Going fast part way through keeps the start, so this on part ends early
+  light1.setToFast();
+  EXPECT_EQ(1000 + fastOnLengthValue, light1.changeTime);
+  light1.update(1000 + fastOnLengthValue - 1);
+  EXPECT_EQ(maxLightLevelValue, lightVariable);
+  light1.update(1000 + fastOnLengthValue);
+  EXPECT_EQ(OFF, lightVariable);
+  EXPECT_EQ(1000 + fastOnLengthValue + fastOffLengthValue, light1.changeTime);
+
+  // And back to slow, this off part now ends later
+  light1.setToSlow();
+  EXPECT_EQ(1000 + fastOnLengthValue + slowOffLengthValue, light1.changeTime);
+
+  // On, off and flash work as for the other lights
+  light1.on();
+  light1.update(5000);
+  EXPECT_EQ(onLightLevelValue, lightVariable);
+  EXPECT_EQ(Light::LIGHT_ON, light1.getLightMode());
+  light1.off();
+  light1.update(6000);
+  EXPECT_EQ(OFF, lightVariable);
+  light1.flash();
+  EXPECT_EQ(maxLightLevelValue, lightVariable);
+  EXPECT_EQ(Light::LIGHT_FLASHING, light1.getLightMode());
 }
 
 TEST(FastSlowBlinkingLight, FunctionCallOperatorGetValue) {
@@ -1518,19 +1672,470 @@ TEST(FastSlowBlinkingLight, FunctionCallOperatorGetValue) {
 
   light1.setToSlow();
 
-  EXPECT_EQ(onLightLevelValue, light1.p_currentLight->onLightLevel);
-  *light1.p_currentLight->p_lightLevel = ON;
+  EXPECT_EQ(onLightLevelValue, light1.onLightLevel);
+  *light1.p_lightLevel = ON;
   EXPECT_EQ(ON, light1());
   EXPECT_EQ(ON, lightVariable);
 
-  *light1.p_currentLight->p_lightLevel = OFF;
+  *light1.p_lightLevel = OFF;
   EXPECT_EQ(OFF, light1());
   EXPECT_EQ(OFF, lightVariable);
 
   for (uint8_t i = 0; i < ON; i++) {
-    *light1.p_currentLight->p_lightLevel = i;
+    *light1.p_lightLevel = i;
     EXPECT_EQ(i, light1());
     EXPECT_EQ(i, lightVariable);
   }
     
 }
+
+TEST(StaticLight, NoVirtualFunctions)
+{
+  EXPECT_TRUE (std::is_polymorphic<Light>::value);
+  EXPECT_FALSE(std::is_polymorphic<StaticLight>::value);
+  EXPECT_FALSE((std::is_polymorphic<StaticDecayLight<110, 1110, ON, 175> >::value));
+  EXPECT_FALSE((std::is_polymorphic<StaticRotatingLight<250, 0, 736, 20, ON> >::value));
+}
+
+TEST(StaticLight, OnOffToggle)
+{
+  uint8_t lightVariable;
+
+  StaticLight light1;
+  EXPECT_EQ(Light::LIGHT_MODE_NOTSET, light1.getLightMode());
+  light1.setup(lightVariable, onLightLevelValue);
+  EXPECT_EQ(Light::LIGHT_OFF, light1.getLightMode());
+  EXPECT_EQ(OFF, lightVariable);
+
+  light1.on();
+  EXPECT_EQ(Light::LIGHT_ON, light1.getLightMode());
+  EXPECT_EQ(onLightLevelValue, light1());
+  light1.toggle();
+  EXPECT_EQ(Light::LIGHT_OFF, light1.getLightMode());
+  EXPECT_EQ(OFF, light1());
+  light1.toggle();
+  EXPECT_EQ(Light::LIGHT_ON, light1.getLightMode());
+  EXPECT_EQ(onLightLevelValue, lightVariable);
+}
+
+TEST(StaticDecayLight, MatchesDecayLight)
+{
+  // B-29 position light settings, and a scaled down landing light (no tau)
+  const DecayLight::Interval intervals[1] = {
+    {LUCKY7_DURATION(110), LUCKY7_DURATION(1110), LUCKY7_DURATION(175), ON}};
+  const DecayLight::Interval flashIntervals[1] = {
+    {LUCKY7_DURATION(3000), LUCKY7_DURATION(600), 0, maxLightLevelValue}};
+
+  const uint16_t steps = 3000;
+
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, millis())
+    .Times(4*steps);
+
+  uint8_t dynamicVariable, staticVariable;
+  uint8_t dynamicFlashVariable, staticFlashVariable;
+
+  DecayLight dynamicLight;
+  dynamicLight.setup(dynamicVariable, onLightLevelValue, 1, intervals);
+  StaticDecayLight<110, 1110, ON, 175> staticLight;
+  staticLight.setup(staticVariable, onLightLevelValue);
+
+  FlashingLight dynamicFlash;
+  dynamicFlash.setup(dynamicFlashVariable, onLightLevelValue, 1,
+                     flashIntervals);
+  StaticDecayLight<3000, 600, maxLightLevelValue, 0> staticFlash;
+  staticFlash.setup(staticFlashVariable, onLightLevelValue);
+
+  EXPECT_EQ(dynamicLight.getLightMode(), staticLight.getLightMode());
+
+  uint32_t timeMS = 0;
+  for (uint16_t i = 0; i < steps; i++) {
+    if (i == 1000) {
+      dynamicLight.on(); staticLight.on();
+      dynamicFlash.off(); staticFlash.off();
+    }
+    if (i == 1500) {
+      dynamicLight.flash(); staticLight.flash();
+      dynamicFlash.flash(); staticFlash.flash();
+    }
+    arduinoMock->setMillisRaw(timeMS);
+    dynamicLight.update();
+    staticLight.update();
+    dynamicFlash.update();
+    staticFlash.update();
+    EXPECT_EQ(dynamicLight(), staticLight()) << "i = " << i << std::endl;
+    EXPECT_EQ(dynamicLight.getDecaying(), staticLight.getDecaying())
+      << "i = " << i << std::endl;
+    EXPECT_EQ(dynamicLight.getLightMode(), staticLight.getLightMode());
+    EXPECT_EQ(dynamicFlash(), staticFlash()) << "i = " << i << std::endl;
+    timeMS += (i % 7 == 0) ? 37 : 10; // Mostly 10 ms ticks, some late
+  }
+
+  releaseArduinoMock();
+}
+
+TEST(StaticRotatingLight, MatchesRotatingLight)
+{
+  // B-52c collision light settings
+  const uint16_t steps = 2000;
+
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, millis())
+    .Times(2*steps);
+
+  uint8_t dynamicVariable, staticVariable;
+
+  RotatingLight dynamicLight;
+  dynamicLight.setup(dynamicVariable, ON, 250, 0, 736, 20, ON);
+  StaticRotatingLight<250, 0, 736, 20, ON> staticLight;
+  staticLight.setup(staticVariable, ON);
+
+  uint32_t timeMS = 0;
+  for (uint16_t i = 0; i < steps; i++) {
+    if (i == 500) {
+      dynamicLight.on(); staticLight.on();
+    }
+    if (i == 800) {
+      dynamicLight.flash(); staticLight.flash();
+    }
+    arduinoMock->setMillisRaw(timeMS);
+    dynamicLight.update();
+    staticLight.update();
+    EXPECT_EQ(dynamicLight(), staticLight()) << "i = " << i << std::endl;
+    EXPECT_EQ(dynamicLight.getPulsing(), staticLight.getPulsing())
+      << "i = " << i << std::endl;
+    timeMS += 10;
+  }
+
+  releaseArduinoMock();
+}
+
+TEST(LightBank, AddLight)
+{
+  uint8_t onOffVariable = ON;
+  uint8_t decayVariable = ON;
+
+  const DecayLight::Interval intervals[2] = {
+    {LUCKY7_DURATION(50), LUCKY7_DURATION( 250), 0, ON},
+    {LUCKY7_DURATION(50), LUCKY7_DURATION(1500), 0, 100}};
+
+  LightBank<LIGHTBANK_MAXCHANNELS> bank;
+  bank.setup();
+  EXPECT_EQ(0, bank.getNumChannels());
+
+  EXPECT_EQ(0, bank.addLight(onOffVariable, onLightLevelValue));
+  EXPECT_EQ(1, bank.addDecayLight(decayVariable, onLightLevelValue, 2,
+                                  intervals));
+  EXPECT_EQ(2, bank.getNumChannels());
+
+  EXPECT_EQ(OFF, onOffVariable);
+  EXPECT_EQ(Light::LIGHT_OFF, bank.getLightMode(0));
+  EXPECT_EQ(0, bank.numIntervals[0]);
+
+  EXPECT_EQ(OFF, decayVariable);
+  EXPECT_EQ(Light::LIGHT_FLASHING, bank.getLightMode(1));
+  EXPECT_EQ(true, bank.getDecaying(1));
+  EXPECT_EQ(2, bank.numIntervals[1]);
+  EXPECT_EQ(0, bank.changeTime[1]);
+  EXPECT_EQ(0, bank.getNextUpdateTime());
+
+  bank.toggle(0);
+  EXPECT_EQ(onLightLevelValue, onOffVariable);
+  EXPECT_EQ(Light::LIGHT_ON, bank.getLightMode(0));
+  bank.flash(0); // On/Off lights do not flash
+  EXPECT_EQ(Light::LIGHT_ON, bank.getLightMode(0));
+
+  bank.allOn();
+  EXPECT_EQ(onLightLevelValue, decayVariable);
+  EXPECT_EQ(Light::LIGHT_ON, bank.getLightMode(1));
+  bank.allOff();
+  EXPECT_EQ(OFF, onOffVariable);
+  EXPECT_EQ(OFF, decayVariable);
+  bank.flash(1);
+  EXPECT_EQ(Light::LIGHT_FLASHING, bank.getLightMode(1));
+  EXPECT_EQ(Light::LIGHT_OFF, bank.getLightMode(0));
+
+  // Adds past LIGHTBANK_MAXCHANNELS are ignored, and so is their channel
+  uint8_t variables[LIGHTBANK_MAXCHANNELS];
+  uint8_t i;
+  for (i = 2; i < LIGHTBANK_MAXCHANNELS; i++) {
+    EXPECT_EQ(i, bank.addLight(variables[i], onLightLevelValue));
+  }
+  uint8_t extraVariable = ON;
+  EXPECT_EQ(LIGHTBANK_FULL, bank.addLight(extraVariable, onLightLevelValue));
+  EXPECT_EQ(LIGHTBANK_FULL, bank.addDecayLight(extraVariable, onLightLevelValue,
+                                               2, intervals));
+  EXPECT_EQ(LIGHTBANK_MAXCHANNELS, bank.getNumChannels());
+  EXPECT_EQ(ON, extraVariable);
+  bank.on    (LIGHTBANK_FULL);
+  bank.off   (LIGHTBANK_FULL);
+  bank.flash (LIGHTBANK_FULL);
+  bank.toggle(LIGHTBANK_FULL);
+  bank.update(0);
+  EXPECT_EQ(ON, extraVariable);
+}
+
+TEST(LightBank, MatchesDecayLight)
+{
+  // F-16 position and collision lights, plus a plain light
+  const DecayLight::Interval positionIntervals[1] = {
+    {LUCKY7_DURATION(100), LUCKY7_DURATION(1100), LUCKY7_DURATION(100), ON}};
+  const DecayLight::Interval collisionIntervals[2] = {
+    {LUCKY7_DURATION(50), LUCKY7_DURATION( 250), 0, ON},
+    {LUCKY7_DURATION(50), LUCKY7_DURATION(1500), 0, maxLightLevelValue}};
+
+  const uint16_t steps = 3000;
+
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+  // One millis() per bank update, one per DecayLight::update()
+  EXPECT_CALL(*arduinoMock, millis())
+    .Times(3*steps);
+
+  uint8_t bankOutputs[3], dueOutputs[3];
+  uint8_t positionVariable, collisionVariable, floodsVariable;
+
+  DecayLight position;
+  position.setup(positionVariable, onLightLevelValue, 1, positionIntervals);
+  FlashingLight collision;
+  collision.setup(collisionVariable, onLightLevelValue, 2, collisionIntervals);
+  Light floods;
+  floods.setup(floodsVariable, onLightLevelValue);
+
+  // bank is updated every tick, dueBank only when updateIfDue() says so
+  LightBank<3> bank, dueBank;
+  bank.setup();
+  dueBank.setup();
+  const uint8_t bankPosition =
+    bank.addDecayLight(bankOutputs[0], onLightLevelValue, 1, positionIntervals);
+  const uint8_t bankCollision =
+    bank.addDecayLight(bankOutputs[1], onLightLevelValue, 2, collisionIntervals);
+  const uint8_t bankFloods = bank.addLight(bankOutputs[2], onLightLevelValue);
+  dueBank.addDecayLight(dueOutputs[0], onLightLevelValue, 1, positionIntervals);
+  dueBank.addDecayLight(dueOutputs[1], onLightLevelValue, 2, collisionIntervals);
+  dueBank.addLight(dueOutputs[2], onLightLevelValue);
+
+  Light::skippedUpdates = 0;
+  uint32_t timeMS = 0;
+  for (uint16_t i = 0; i < steps; i++) {
+    if (i == 700) {
+      position.on(); bank.on(bankPosition);  dueBank.on(bankPosition);
+      floods.on();   bank.on(bankFloods);    dueBank.on(bankFloods);
+    }
+    if (i == 1200) {
+      position.flash();  bank.flash(bankPosition); dueBank.flash(bankPosition);
+      collision.off();   bank.off(bankCollision);  dueBank.off(bankCollision);
+    }
+    if (i == 1900) {
+      collision.flash(); bank.flash(bankCollision); dueBank.flash(bankCollision);
+      floods.toggle();   bank.toggle(bankFloods);   dueBank.toggle(bankFloods);
+    }
+    arduinoMock->setMillisRaw(timeMS);
+    position.update();
+    collision.update();
+    floods.update();
+    bank.update();
+    updateIfDue(dueBank, timeMS);
+
+    EXPECT_EQ(position(),  bankOutputs[0]) << "i = " << i << std::endl;
+    EXPECT_EQ(collision(), bankOutputs[1]) << "i = " << i << std::endl;
+    EXPECT_EQ(floods(),    bankOutputs[2]) << "i = " << i << std::endl;
+    EXPECT_EQ(bankOutputs[0], dueOutputs[0]) << "i = " << i << std::endl;
+    EXPECT_EQ(bankOutputs[1], dueOutputs[1]) << "i = " << i << std::endl;
+    EXPECT_EQ(bankOutputs[2], dueOutputs[2]) << "i = " << i << std::endl;
+    EXPECT_EQ(position.getDecaying(),  bank.getDecaying(bankPosition));
+    EXPECT_EQ(collision.getDecaying(), bank.getDecaying(bankCollision));
+    EXPECT_EQ(position.getLightMode(),  bank.getLightMode(bankPosition));
+    EXPECT_EQ(collision.getLightMode(), bank.getLightMode(bankCollision));
+    EXPECT_EQ(floods.getLightMode(),    bank.getLightMode(bankFloods));
+    timeMS += (i % 11 == 0) ? 1500 : 10; // Mostly 10 ms ticks, some very late
+  }
+
+  // Both channels sit off between flashes most of the time
+  EXPECT_LT(steps/4, Light::skippedUpdates);
+
+  releaseArduinoMock();
+}
+
+TEST(Light, UpdateIfDueMatchesUpdate)
+{
+  // B-29 position light, a long flashing interval like the landing lights
+  // and the B-52c collision light, each updated every tick and only when due
+  const DecayLight::Interval intervals[1] = {
+    {LUCKY7_DURATION(110), LUCKY7_DURATION(1110), LUCKY7_DURATION(175), ON}};
+  const DecayLight::Interval flashIntervals[2] = {
+    {LUCKY7_DURATION(3000), LUCKY7_DURATION( 600), 0, maxLightLevelValue},
+    {LUCKY7_DURATION( 500), LUCKY7_DURATION(4000), 0, ON}};
+
+  const uint16_t steps = 3000;
+
+  uint8_t everyDecayVariable, dueDecayVariable;
+  uint8_t everyFlashVariable, dueFlashVariable;
+  uint8_t everyRotateVariable, dueRotateVariable;
+  uint8_t onVariable;
+
+  DecayLight everyDecay, dueDecay;
+  everyDecay.setup(everyDecayVariable, onLightLevelValue, 1, intervals);
+  dueDecay.setup(dueDecayVariable, onLightLevelValue, 1, intervals);
+
+  FlashingLight everyFlash, dueFlash;
+  everyFlash.setup(everyFlashVariable, onLightLevelValue, 2, flashIntervals);
+  dueFlash.setup(dueFlashVariable, onLightLevelValue, 2, flashIntervals);
+
+  RotatingLight everyRotate, dueRotate;
+  everyRotate.setup(everyRotateVariable, ON, 250, 0, 736, 20, ON);
+  dueRotate.setup(dueRotateVariable, ON, 250, 0, 736, 20, ON);
+
+  Light onLight;
+  onLight.setup(onVariable, onLightLevelValue);
+  onLight.on();
+  EXPECT_EQ(0xFFFFFFFF, onLight.getNextUpdateTime());
+
+  Light::skippedUpdates = 0;
+
+  uint32_t timeMS = 0;
+  for (uint16_t i = 0; i < steps; i++) {
+    if (i == 1000) {
+      everyDecay.on();   dueDecay.on();
+      everyRotate.on();  dueRotate.on();
+    }
+    if (i == 1500) {
+      everyDecay.flash();  dueDecay.flash();
+      everyFlash.flash();  dueFlash.flash();
+      everyRotate.flash(); dueRotate.flash();
+    }
+    if (i == 2200) {
+      everyFlash.off();  dueFlash.off();
+    }
+    if (i == 2300) {
+      // Flash during an off interval must still turn the light off again
+      everyFlash.flash();  dueFlash.flash();
+    }
+    everyDecay.update(timeMS);
+    everyFlash.update(timeMS);
+    everyRotate.update(timeMS);
+    updateIfDue(dueDecay,  timeMS);
+    updateIfDue(dueFlash,  timeMS);
+    updateIfDue(dueRotate, timeMS);
+    updateIfDue(onLight,   timeMS);
+
+    EXPECT_EQ(everyDecay(),  dueDecay())  << "i = " << i << std::endl;
+    EXPECT_EQ(everyFlash(),  dueFlash())  << "i = " << i << std::endl;
+    EXPECT_EQ(everyRotate(), dueRotate()) << "i = " << i << std::endl;
+    EXPECT_EQ(onLightLevelValue, onLight());
+    timeMS += (i % 7 == 0) ? 37 : 10; // Mostly 10 ms ticks, some late
+  }
+
+  // The On light skips every update, and the others most of theirs
+  EXPECT_LT(2*steps, Light::skippedUpdates);
+}
+
+TEST(SequenceLight, Setup)
+{
+  const SequenceLight::Key track[2] PROGMEM = {
+    {100, ON,  SequenceLight::STEP},
+    {200, OFF, SequenceLight::LINEAR}};
+
+  EXPECT_EQ(4u, sizeof(SequenceLight::Key));
+
+  uint8_t lightVariable = 123;
+  SequenceLight light;
+  light.setup(lightVariable, onLightLevelValue, track, 2);
+
+  EXPECT_EQ(track, light.track);
+  EXPECT_EQ(2, light.numKeys);
+  EXPECT_EQ(1, light.keyIndex);
+  EXPECT_EQ(0u, light.changeTime);
+  EXPECT_EQ(OFF, light());
+  EXPECT_EQ(Light::LIGHT_FLASHING, light.getLightMode());
+}
+
+TEST(SequenceLight, EmptyTrack)
+{
+  // With no keys to read, the light stays an On/Off light
+  uint8_t lightVariable = 123;
+  SequenceLight light;
+  light.setup(lightVariable, onLightLevelValue, NULL, 0);
+
+  EXPECT_EQ(0, light.numKeys);
+  EXPECT_EQ(0, light.keyIndex);
+  EXPECT_EQ(OFF, light());
+  EXPECT_EQ(Light::LIGHT_OFF, light.getLightMode());
+  EXPECT_EQ(0xFFFFFFFF, light.getNextUpdateTime());
+
+  light.update(0);
+  light.update(1000);
+  EXPECT_EQ(OFF, light());
+  EXPECT_EQ(0, light.keyIndex);
+
+  light.flash();
+  EXPECT_EQ(Light::LIGHT_OFF, light.getLightMode());
+  EXPECT_EQ(OFF, light());
+
+  light.on();
+  updateIfDue(light, 2000);
+  EXPECT_EQ(onLightLevelValue, light());
+  EXPECT_EQ(Light::LIGHT_ON, light.getLightMode());
+}
+
+TEST(SequenceLight, Update)
+{
+  const SequenceLight::Key track[4] PROGMEM = {
+    {100, ON,  SequenceLight::STEP},
+    {200, 55,  SequenceLight::LINEAR},
+    {500, OFF, SequenceLight::DECAY},
+    {200, 200, SequenceLight::LINEAR}};
+
+  uint8_t lightVariable;
+  SequenceLight light;
+  light.setup(lightVariable, onLightLevelValue, track, 4);
+
+  light.update(0);
+  EXPECT_EQ(0, light.getKeyIndex());
+  EXPECT_EQ(ON, light());
+  light.update(50);
+  EXPECT_EQ(ON, light());
+  EXPECT_EQ(100u, light.getNextUpdateTime());
+
+  light.update(100);
+  EXPECT_EQ(1, light.getKeyIndex());
+  EXPECT_EQ(ON, light());
+  EXPECT_EQ(0u, light.getNextUpdateTime());
+  light.update(200);
+  EXPECT_EQ(155, light());
+
+  light.update(300);
+  EXPECT_EQ(2, light.getKeyIndex());
+  EXPECT_EQ(55, light());
+  light.update(400);
+  EXPECT_EQ(DecayLight::decayLevel(55, 100, 100), light());
+  light.update(799);
+  EXPECT_EQ(OFF, light());
+
+  light.update(800);
+  EXPECT_EQ(3, light.getKeyIndex());
+  EXPECT_EQ(OFF, light());
+  light.update(900);
+  EXPECT_EQ(100, light());
+
+  light.update(1000);
+  EXPECT_EQ(0, light.getKeyIndex());
+  EXPECT_EQ(ON, light());
+
+  // Called very late, start the next key now
+  light.update(5000);
+  EXPECT_EQ(1, light.getKeyIndex());
+  EXPECT_EQ(ON, light());
+  EXPECT_EQ(5200u, light.changeTime);
+  light.update(5100);
+  EXPECT_EQ(155, light());
+
+  light.on();
+  light.update(5150);
+  EXPECT_EQ(onLightLevelValue, light());
+  EXPECT_EQ(5200u, light.getNextUpdateTime());
+  light.flash();
+  EXPECT_EQ(ON, light());
+  light.update(5200);
+  EXPECT_EQ(2, light.getKeyIndex());
+  EXPECT_EQ(55, light());
+}
@@ -2,6 +2,7 @@
 #include "pins_arduino.h"
 #include <IRremote.h>
 #include <gtest/gtest.h>
+#include <algorithm>
 
 
 using ::testing::_;
@@ -35,23 +36,25 @@ TEST(Lucky7Test, Setup) {
   EXPECT_EQ(0, lucky7.o8 );
   EXPECT_EQ(0, lucky7.o13);
 
-  EXPECT_EQ(0, lucky7.o1Saved);
-  EXPECT_EQ(0, lucky7.o2Saved);
-  EXPECT_EQ(0, lucky7.o3Saved);
-  EXPECT_EQ(0, lucky7.o4Saved);
-  EXPECT_EQ(0, lucky7.o5Saved);
-  EXPECT_EQ(0, lucky7.o6Saved);
-  EXPECT_EQ(0, lucky7.o7Saved);
-
-  EXPECT_EQ(0, lucky7.irTimeout);
-
-  EXPECT_EQ(0, lucky7.aveptr);
-
-  for (uint8_t i = 0; i < AVECNT; i++) {
-    EXPECT_EQ(0, lucky7.pc1[i]);
-    EXPECT_EQ(0, lucky7.pc2[i]);
-    EXPECT_EQ(0, lucky7.bc [i]);
-  }
+  EXPECT_EQ(0, lucky7.oSaved[0]);
+  EXPECT_EQ(0, lucky7.oSaved[1]);
+  EXPECT_EQ(0, lucky7.oSaved[2]);
+  EXPECT_EQ(0, lucky7.oSaved[3]);
+  EXPECT_EQ(0, lucky7.oSaved[4]);
+  EXPECT_EQ(0, lucky7.oSaved[5]);
+  EXPECT_EQ(0, lucky7.oSaved[6]);
+
+  EXPECT_EQ(0, lucky7.irHeldKey);
+
+  EXPECT_EQ(0, lucky7.samplesPrimed);
+  EXPECT_EQ(LUCKY7_PHOTOCELLSAMPLETIME,
+            lucky7.sampleInterval[LUCKY7_SENSORPHOTOCELL1]);
+  EXPECT_EQ(LUCKY7_BATTERYSAMPLETIME,
+            lucky7.sampleInterval[LUCKY7_SENSORBATTERY]);
+
+  EXPECT_EQ(0, lucky7.photocell1());
+  EXPECT_EQ(0, lucky7.photocell2());
+  EXPECT_EQ(0, lucky7.batteryVoltage());
               
   releaseArduinoMock();
   releaseIRrecvMock();
@@ -61,13 +64,13 @@ TEST(Lucky7Test, SaveOutputState) {
 
   Lucky7 lucky7 = Lucky7();
 
-  lucky7.o1Saved = 0;
-  lucky7.o2Saved = 0;
-  lucky7.o3Saved = 0;
-  lucky7.o4Saved = 0;
-  lucky7.o5Saved = 0;
-  lucky7.o6Saved = 0;
-  lucky7.o7Saved = 0;
+  lucky7.oSaved[0] = 0;
+  lucky7.oSaved[1] = 0;
+  lucky7.oSaved[2] = 0;
+  lucky7.oSaved[3] = 0;
+  lucky7.oSaved[4] = 0;
+  lucky7.oSaved[5] = 0;
+  lucky7.oSaved[6] = 0;
 
   lucky7.o1 = 1;
   lucky7.o2 = 2;
@@ -76,16 +79,20 @@ TEST(Lucky7Test, SaveOutputState) {
   lucky7.o5 = 5;
   lucky7.o6 = 6;
   lucky7.o7 = 7;
+  lucky7.o8 = 8;
+  lucky7.o13 = 13;
 
   lucky7.saveOutputState();
 
-  EXPECT_EQ(1, lucky7.o1Saved);
-  EXPECT_EQ(2, lucky7.o2Saved);
-  EXPECT_EQ(3, lucky7.o3Saved);
-  EXPECT_EQ(4, lucky7.o4Saved);
-  EXPECT_EQ(5, lucky7.o5Saved);
-  EXPECT_EQ(6, lucky7.o6Saved);
-  EXPECT_EQ(7, lucky7.o7Saved);
+  EXPECT_EQ(8 , lucky7.oSaved[7]);
+  EXPECT_EQ(13, lucky7.oSaved[8]);
+  EXPECT_EQ(1, lucky7.oSaved[0]);
+  EXPECT_EQ(2, lucky7.oSaved[1]);
+  EXPECT_EQ(3, lucky7.oSaved[2]);
+  EXPECT_EQ(4, lucky7.oSaved[3]);
+  EXPECT_EQ(5, lucky7.oSaved[4]);
+  EXPECT_EQ(6, lucky7.oSaved[5]);
+  EXPECT_EQ(7, lucky7.oSaved[6]);
 }
 
 TEST(Lucky7Test, SetOutputStateFromSaved) {
@@ -100,16 +107,21 @@ TEST(Lucky7Test, SetOutputStateFromSaved) {
   lucky7.o6 = 0;
   lucky7.o7 = 0;
 
-  lucky7.o1Saved = 1;
-  lucky7.o2Saved = 2;
-  lucky7.o3Saved = 3;
-  lucky7.o4Saved = 4;
-  lucky7.o5Saved = 5;
-  lucky7.o6Saved = 6;
-  lucky7.o7Saved = 7;
+  lucky7.oSaved[0] = 1;
+  lucky7.oSaved[1] = 2;
+  lucky7.oSaved[2] = 3;
+  lucky7.oSaved[3] = 4;
+  lucky7.oSaved[4] = 5;
+  lucky7.oSaved[5] = 6;
+  lucky7.oSaved[6] = 7;
+  lucky7.oSaved[7] = 8;
+  lucky7.oSaved[8] = 13;
 
   lucky7.setOutputStateFromSaved();
 
+  EXPECT_EQ(8 , lucky7.o8);
+  EXPECT_EQ(13, lucky7.o13);
+
   EXPECT_EQ(1, lucky7.o1);
   EXPECT_EQ(2, lucky7.o2);
   EXPECT_EQ(3, lucky7.o3);
@@ -147,10 +159,11 @@ TEST(Lucky7Test, Loop) {
   EXPECT_CALL(*arduinoMock, millis())
     .Times(loopTimes);
 
-  EXPECT_CALL(*arduinoMock, analogWrite(AnyOf(O1,O2,O3,O5,O6,O7),_))
-    .Times(loopTimes*6);
-  EXPECT_CALL(*arduinoMock, digitalWrite(AnyOf(O4,O8,O13),_))
-    .Times(loopTimes*3);
+  // Outputs stay off, so are never written
+  EXPECT_CALL(*arduinoMock, analogWrite(_,_))
+    .Times(0);
+  EXPECT_CALL(*arduinoMock, digitalWrite(_,_))
+    .Times(0);
            
   EXPECT_CALL(*arduinoMock, analogRead(A0))
     .Times(loopTimes)
@@ -164,20 +177,29 @@ TEST(Lucky7Test, Loop) {
     .Times(loopTimes)
     .WillRepeatedly(Invoke(counterValue));
 
+  // No codes, so nothing to resume after
   IRrecvMock * irrecvMock = irrecvMockInstance();
-  EXPECT_CALL(*irrecvMock, resume())
+  EXPECT_CALL(*irrecvMock, decode(_))
     .Times(loopTimes);
+  EXPECT_CALL(*irrecvMock, resume())
+    .Times(0);
 
   Lucky7 lucky7 = Lucky7();
+  PhotocellFilter photocell;
 
   for (uint8_t j = 0; j < loopTimes; j++) {
-    uint8_t i = j % AVECNT;
     rv = lucky7.loop();
-    
-    EXPECT_LT(i, AVECNT);
-    EXPECT_EQ(j, lucky7.pc1[i]);
-    EXPECT_EQ(j, lucky7.pc2[i]);
-    EXPECT_EQ(j, lucky7.bc[i]);
+
+    // The first sample, 0, fills the average, then 1, 2, .. j push it out
+    uint16_t sum = 0;
+    for (uint8_t k = (j < AVECNT) ? 1 : j - AVECNT + 1; k <= j; k++) {
+      sum += k;
+    }
+    (j == 0) ? photocell.reset(0) : photocell.add(j);
+    EXPECT_EQ(photocell.value(), lucky7.photocell1()) << "j = " << int(j);
+    EXPECT_EQ(photocell.value(), lucky7.photocell2()) << "j = " << int(j);
+    EXPECT_GT(1.0e-4, fabs(lucky7.batteryVoltage() - (sum/AVECNT)*BVSCALE))
+      << "j = " << int(j);
 
     EXPECT_EQ(0, rv);
   }
@@ -186,137 +208,585 @@ TEST(Lucky7Test, Loop) {
   releaseIRrecvMock();
 }
 
-TEST(Lucky7Test, IRLoop) {
-  uint32_t rv = 0;
+TEST(Lucky7Test, OutputChannels) {
+  Lucky7 lucky7 = Lucky7();
+
+  // o1..o13 are output(0..8)
+  const uint8_t pins[LUCKY7_NUMOUTPUTS] = {O1,O2,O3,O4,O5,O6,O7,O8,O13};
+  uint8_t * const named[LUCKY7_NUMOUTPUTS] = {
+    &lucky7.o1, &lucky7.o2, &lucky7.o3, &lucky7.o4, &lucky7.o5,
+    &lucky7.o6, &lucky7.o7, &lucky7.o8, &lucky7.o13};
+  for (uint8_t i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    EXPECT_EQ(named[i], &lucky7.output(i));
+    EXPECT_EQ(pins[i], Lucky7::outputPin(i));
+    EXPECT_EQ(i != 3 && i < 7, Lucky7::outputDimmable(i));
+  }
+
+  lucky7.outputOn(0);
+  lucky7.outputSet(4, 100);
+  lucky7.outputToggle(8);
+  EXPECT_EQ(ON , lucky7.o1);
+  EXPECT_EQ(100, lucky7.o5);
+  EXPECT_EQ(ON , lucky7.o13);
+
+  lucky7.outputToggle(8);
+  lucky7.outputOff(0);
+  EXPECT_EQ(OFF, lucky7.o13);
+  EXPECT_EQ(OFF, lucky7.o1);
+
+  lucky7.o8 = ON;
+  lucky7.allOutputsOff();
+  for (uint8_t i = 0; i < LUCKY7_NUMOUTPUTS; i++) {
+    EXPECT_EQ(OFF, lucky7.output(i));
+  }
+}
+
+TEST(Lucky7Test, CommitOutputs) {
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+
+  EXPECT_CALL(*arduinoMock, pinMode(_,_))
+    .Times(AtLeast(1));
+  IRrecvMock * irrecvMock = irrecvMockInstance();
+  EXPECT_CALL(*irrecvMock, enableIRIn())
+    .Times(1);
+
+  Lucky7 lucky7 = Lucky7();
+  lucky7.setup();
+
+  // After setup() every pin is written once, whatever its value
+  EXPECT_CALL(*arduinoMock, analogWrite(AnyOf(O1,O2,O3,O5,O6,O7),0))
+    .Times(6);
+  EXPECT_CALL(*arduinoMock, digitalWrite(AnyOf(O4,O8,O13),LOW))
+    .Times(3);
+  uint8_t value[9] = {0, 0, 0, LOW, 0, 0, 0, LOW, LOW};
+  lucky7.commitOutputs(value);
+  EXPECT_EQ(9u, lucky7.outputWrites);
+
+  // Then nothing until a value changes
+  lucky7.commitOutputs(value);
+  EXPECT_EQ(9u, lucky7.outputWrites);
+
+  // Only the pins that changed are written
+  EXPECT_CALL(*arduinoMock, analogWrite(O2,100))
+    .Times(1);
+  EXPECT_CALL(*arduinoMock, digitalWrite(O8,HIGH))
+    .Times(1);
+  value[1] = 100;
+  value[7] = HIGH;
+  lucky7.commitOutputs(value);
+  lucky7.commitOutputs(value);
+  EXPECT_EQ(11u, lucky7.outputWrites);
+  EXPECT_EQ(0, lucky7.oDirty);
+
+  releaseArduinoMock();
+  releaseIRrecvMock();
+}
+
+TEST(Lucky7Test, SampleSensors) {
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+
+  EXPECT_CALL(*arduinoMock, pinMode(_,_))
+    .Times(AtLeast(1));
+  IRrecvMock * irrecvMock = irrecvMockInstance();
+  EXPECT_CALL(*irrecvMock, enableIRIn())
+    .Times(1);
+
+  Lucky7 lucky7 = Lucky7();
+  lucky7.setup();
+  lucky7.setSampleInterval(LUCKY7_SENSORPHOTOCELL2, 500);
 
+  // Over 10 seconds, every 10 ms: each sensor is read once at the start,
+  // then at its own rate
+  EXPECT_CALL(*arduinoMock, analogRead(A4))
+    .Times(1 + 10000/LUCKY7_PHOTOCELLSAMPLETIME)
+    .WillRepeatedly(::testing::Return(100));
+  EXPECT_CALL(*arduinoMock, analogRead(A5))
+    .Times(1 + 10000/500)
+    .WillRepeatedly(::testing::Return(200));
+  EXPECT_CALL(*arduinoMock, analogRead(A0))
+    .Times(1 + 10000/LUCKY7_BATTERYSAMPLETIME)
+    .WillRepeatedly(::testing::Return(300));
+
+  for (uint32_t now = 0; now <= 10000; now += 10) {
+    lucky7.sampleSensors(now);
+    // The first sample fills the whole average
+    EXPECT_EQ(100 << PhotocellFilter::extraBits, lucky7.photocell1());
+    EXPECT_EQ(200 << PhotocellFilter::extraBits, lucky7.photocell2());
+    EXPECT_GT(1.0e-4, fabs(lucky7.batteryVoltage() - 300*BVSCALE));
+  }
+  EXPECT_EQ(0x7, lucky7.samplesPrimed);
+
+  releaseArduinoMock();
+  releaseIRrecvMock();
+}
+
+TEST(Lucky7Test, AdcRead) {
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+  EXPECT_CALL(*arduinoMock, analogRead(A1))
+    .WillOnce(::testing::Return(42))
+    .WillOnce(::testing::Return(43))
+    .WillOnce(::testing::Return(45));
+  EXPECT_CALL(*arduinoMock, analogRead(A2))
+    .WillOnce(::testing::Return(44));
+  EXPECT_CALL(*arduinoMock, analogRead(A4))
+    .WillOnce(::testing::Return(100));
+  EXPECT_CALL(*arduinoMock, analogRead(A5))
+    .WillOnce(::testing::Return(200));
+  EXPECT_CALL(*arduinoMock, analogRead(A0))
+    .WillOnce(::testing::Return(300));
+
+  // The first call starts the conversion, the next one collects it
+  Lucky7 lucky7 = Lucky7();
+  uint16_t value = 0;
+  EXPECT_FALSE(lucky7.adcRead(A1, value));
+  EXPECT_EQ(0, value);
+  EXPECT_TRUE(lucky7.adcRead(A1, value));
+  EXPECT_EQ(42, value);
+
+  // A result for another pin is dropped, and this pin converted instead
+  EXPECT_FALSE(lucky7.adcRead(A1, value));
+  EXPECT_FALSE(lucky7.adcRead(A2, value));
+  EXPECT_TRUE(lucky7.adcRead(A2, value));
+  EXPECT_EQ(44, value);
+
+  // Sensor samples taken in between leave the result alone
+  EXPECT_FALSE(lucky7.adcRead(A1, value));
+  lucky7.sampleSensors(0);
+  EXPECT_EQ(100 << PhotocellFilter::extraBits, lucky7.photocell1());
+  EXPECT_TRUE(lucky7.adcRead(A1, value));
+  EXPECT_EQ(45, value);
+
+  releaseArduinoMock();
+}
+
+TEST(Lucky7Test, Frame) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(4);
+    .Times(2); // Once per loop(), nothing else reads the time
+  EXPECT_CALL(*arduinoMock, analogRead(A4))
+    .WillRepeatedly(::testing::Return(100));
+  EXPECT_CALL(*arduinoMock, analogRead(A5))
+    .WillRepeatedly(::testing::Return(200));
+  EXPECT_CALL(*arduinoMock, analogRead(A0))
+    .WillRepeatedly(::testing::Return(300));
 
   IRrecvMock * irrecvMock = irrecvMockInstance();
   EXPECT_CALL(*irrecvMock, resume())
-    .Times(2);
-
+    .Times(AtLeast(1));
   EXPECT_CALL(*irrecvMock, decode(_))
-    .Times(2);
-  
-  Lucky7 lucky7 = Lucky7();
+    .Times(AtLeast(1));
 
-  irrecvMock->setIRValue(10);
+  Lucky7 lucky7 = Lucky7();
 
   arduinoMock->setMillisRaw(0);
-  rv = lucky7.irLoop();
-  EXPECT_EQ(0,rv); // Should not have gone into ir read loop
+  EXPECT_EQ(0, lucky7.loop());
+  EXPECT_EQ(0, lucky7.frame.now);
+  EXPECT_EQ(0, lucky7.frame.irKey);
+  EXPECT_EQ(100 << PhotocellFilter::extraBits, lucky7.frame.photocell1);
+  EXPECT_EQ(200 << PhotocellFilter::extraBits, lucky7.frame.photocell2);
+  EXPECT_GT(1.0e-4, fabs(lucky7.frame.batteryVoltage - 300*BVSCALE));
 
+  irrecvMock->setIRValue(10);
   arduinoMock->setMillisRaw(250);
-  rv = lucky7.irLoop();
-  EXPECT_EQ(10,rv); // Should have gone into ir read loop and read value set above
+  EXPECT_EQ(10, lucky7.loop());
+  EXPECT_EQ(250, lucky7.frame.now);
+  EXPECT_EQ(10, lucky7.frame.irKey);
+  EXPECT_EQ(Lucky7::KEY_PRESS, lucky7.frame.irKeyEvent);
+
+  // Frames taken outside loop() leave this pass's frame alone
+  const Lucky7::Frame f = lucky7.captureFrame(400);
+  EXPECT_EQ(400, f.now);
+  EXPECT_EQ(0, f.irKey);
+  EXPECT_EQ(Lucky7::KEY_NONE, f.irKeyEvent);
+  EXPECT_EQ(200 << PhotocellFilter::extraBits, f.photocell2);
+  EXPECT_EQ(250, lucky7.frame.now);
 
-  irrecvMock->setIRValue(20);
+  releaseArduinoMock();
+  releaseIRrecvMock();
+}
 
-  arduinoMock->setMillisRaw(501);
-  rv = lucky7.irLoop();
-  EXPECT_EQ(0,rv); // Should not have gone into ir read loop and gotten default value
+TEST(Lucky7Test, IRLoop) {
+  Lucky7::KeyEvent key;
 
-  arduinoMock->addMillisRaw(751);
-  rv = lucky7.irLoop();
-  EXPECT_EQ(20,rv); // Should have gone into ir read loop and read value set above
+  IRrecvMock * irrecvMock = irrecvMockInstance();
+  EXPECT_CALL(*irrecvMock, decode(_))
+    .Times(AtLeast(1));
+  // Once after each code
+  EXPECT_CALL(*irrecvMock, resume())
+    .Times(9);
+
+  Lucky7 lucky7 = Lucky7();
+  lucky7.setup();
+
+  key = lucky7.irLoop(0);
+  EXPECT_EQ(Lucky7::KEY_NONE, key.type); // No code
+  EXPECT_EQ(0, key.key);
+
+  // First code of a key is a press, whenever it comes
+  irrecvMock->setIRValue(10);
+  key = lucky7.irLoop(1);
+  EXPECT_EQ(Lucky7::KEY_PRESS, key.type);
+  EXPECT_EQ(10, key.key);
+  EXPECT_EQ(1, key.time);
+
+  // Held, the same code or REPEAT come again
+  key = lucky7.irLoop(1 + LUCKY7_IRREPEATTIME);
+  EXPECT_EQ(Lucky7::KEY_REPEAT, key.type);
+  EXPECT_EQ(10, key.key);
+  EXPECT_EQ(1, key.time);
+  irrecvMock->setIRValue(LUCKY7_IRREPEAT);
+  key = lucky7.irLoop(1 + LUCKY7_IRHOLDTIME - 1);
+  EXPECT_EQ(Lucky7::KEY_REPEAT, key.type);
+  EXPECT_EQ(10, key.key);
+  key = lucky7.irLoop(1 + LUCKY7_IRHOLDTIME);
+  EXPECT_EQ(Lucky7::KEY_HOLD, key.type);
+  EXPECT_EQ(10, key.key);
+  EXPECT_EQ(1, key.time);
+
+  // Quick presses of another key are each seen
+  irrecvMock->setIRValue(20);
+  key = lucky7.irLoop(600);
+  EXPECT_EQ(Lucky7::KEY_PRESS, key.type);
+  EXPECT_EQ(20, key.key);
+  EXPECT_EQ(600, key.time);
+  irrecvMock->setIRValue(30);
+  key = lucky7.irLoop(610);
+  EXPECT_EQ(Lucky7::KEY_PRESS, key.type);
+  EXPECT_EQ(30, key.key);
+
+  // Let go and pressed again
+  key = lucky7.irLoop(610 + LUCKY7_IRREPEATTIME + 1);
+  EXPECT_EQ(Lucky7::KEY_PRESS, key.type);
+  EXPECT_EQ(30, key.key);
+  EXPECT_EQ(610 + LUCKY7_IRREPEATTIME + 1, key.time);
+
+  // A REPEAT long after the key was let go has no key to repeat
+  irrecvMock->setIRValue(LUCKY7_IRREPEAT);
+  key = lucky7.irLoop(2000);
+  EXPECT_EQ(Lucky7::KEY_NONE, key.type);
+  key = lucky7.irLoop(2100);
+  EXPECT_EQ(Lucky7::KEY_NONE, key.type);
 
-  releaseArduinoMock();
   releaseIRrecvMock();
 }
 
+TEST(Lucky7Test, IRKeyEventLoopStalled) {
+  Lucky7::KeyEvent key;
+
+  Lucky7 lucky7 = Lucky7();
+  lucky7.setup();
+
+  // A held key's codes queued while loop() was busy for a second are taken
+  // together, but timed from when each was received, so the key stays held
+  key = lucky7.irKeyEvent(10, 1000);
+  EXPECT_EQ(Lucky7::KEY_PRESS, key.type);
+  uint32_t time;
+  for (time = 1110; time < 1000 + LUCKY7_IRHOLDTIME; time += 110) {
+    key = lucky7.irKeyEvent(LUCKY7_IRREPEAT, time);
+    EXPECT_EQ(Lucky7::KEY_REPEAT, key.type) << "time = " << time;
+    EXPECT_EQ(10, key.key);
+  }
+  key = lucky7.irKeyEvent(LUCKY7_IRREPEAT, time);
+  EXPECT_EQ(Lucky7::KEY_HOLD, key.type);
+  EXPECT_EQ(10, key.key);
+  EXPECT_EQ(1000, key.time);
+
+  // A gap between codes, not between taking them, lets the key go
+  key = lucky7.irKeyEvent(LUCKY7_IRREPEAT, time + LUCKY7_IRREPEATTIME + 1);
+  EXPECT_EQ(Lucky7::KEY_NONE, key.type);
+  EXPECT_EQ(0, lucky7.irHeldKey);
+}
+
+TEST(Lucky7Test, IRCodeTime) {
+  Lucky7::KeyEvent key;
+
+  Lucky7 lucky7 = Lucky7();
+  lucky7.setup();
+
+  // Codes are timed from when they ended, not from when loop() took them
+  EXPECT_EQ(1000u, Lucky7::irCodeTime(1400, 5400000, 5000000));
+  EXPECT_EQ(1400u, Lucky7::irCodeTime(1400, 5400000, 5400000));
+  EXPECT_EQ(1392u, Lucky7::irCodeTime(1400, 0x00001000, 0xFFFFF000)); // micros() wrapped
+
+  // A press and a repeat both received 400 ms before loop() took them.
+  // Timed from when taken, the repeat would be LUCKY7_IRREPEATTIME late.
+  const uint32_t now = 1000 + LUCKY7_IRREPEATTIME + 400;
+  key = lucky7.irKeyEvent(10, Lucky7::irCodeTime(1000, 1000000, 1000000));
+  EXPECT_EQ(Lucky7::KEY_PRESS, key.type);
+  key = lucky7.irKeyEvent(LUCKY7_IRREPEAT,
+                          Lucky7::irCodeTime(now, now*1000, (now - 400)*1000));
+  EXPECT_EQ(Lucky7::KEY_REPEAT, key.type);
+  EXPECT_EQ(10, key.key);
+  EXPECT_EQ(1000u, key.time);
+}
+
 TEST(Lucky7Test, Photocell1and2andBatteryVoltage) {
 
   Lucky7 lucky7 = Lucky7();
 
   for (uint8_t i = 0; i < AVECNT; i++) {
-    lucky7.pc1[i] = i+1;
-    lucky7.pc2[i] = i+1;
-    lucky7.bc[i] = i+1;
+    lucky7.bc .add(i+1);
+  }
+
+  // Photocells dithering between 5 and 6 keep the .5 in their extra bits
+  lucky7.pc1.reset(5);
+  lucky7.pc2.reset(5);
+  for (uint16_t i = 0; i < AVECNT << (2*PhotocellFilter::extraBits); i++) {
+    lucky7.pc1.add(5 + (i & 1));
+    lucky7.pc2.add(5);
   }
 
   const uint16_t sumPc1 = lucky7.photocell1();
   const uint16_t sumPc2 = lucky7.photocell2();
   float sumBc  = lucky7.batteryVoltage();
-  EXPECT_EQ(5, sumPc1);
-  EXPECT_EQ(5, sumPc2);
+  EXPECT_EQ(((2*5 + 1) << PhotocellFilter::extraBits)/2, sumPc1);
+  EXPECT_EQ(5 << PhotocellFilter::extraBits, sumPc2);
   EXPECT_GT(1.0e-6, fabs(sumBc - 5.0*BVSCALE));
 }
 
 TEST(Lucky7Test, OutputMoveTo) {
 
-  
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
-  EXPECT_CALL(*arduinoMock, analogWrite(AnyOf(O1,O2),_))
-    .Times(44);
-  EXPECT_CALL(*arduinoMock, analogWrite(O3,_))
-    .Times(11);
-  EXPECT_CALL(*arduinoMock, analogWrite(O4,_))
-    .Times(2);
-  EXPECT_CALL(*arduinoMock, analogWrite(O5,_))
-    .Times(2);
-  EXPECT_CALL(*arduinoMock, analogWrite(O6,_))
-    .Times(2);
-  EXPECT_CALL(*arduinoMock, analogWrite(O7,_))
-    .Times(2);
-  EXPECT_CALL(*arduinoMock, analogWrite(O8,_))
-    .Times(2);
-  EXPECT_CALL(*arduinoMock, analogWrite(O13,_))
+  // Ramps do not write the outputs themselves, loop() does
+  EXPECT_CALL(*arduinoMock, analogWrite(_,_))
+    .Times(0);
+  EXPECT_CALL(*arduinoMock, millis())
     .Times(2);
 
   Lucky7 lucky7 = Lucky7();
+  arduinoMock->setMillisRaw(1000);
 
   lucky7.o1 = 10;
-  lucky7.outputMoveTo(O1,lucky7.o1,20,999);
-  EXPECT_EQ(20, lucky7.o1);
+  lucky7.outputMoveTo(0,20,999);
+  EXPECT_EQ(10, lucky7.o1);
+  EXPECT_EQ(1000u, lucky7.loopTime);
 
   lucky7.o2 = 20;
-  lucky7.outputMoveTo(O2,lucky7.o2,10,999);
-  EXPECT_EQ(10, lucky7.o2);
+  lucky7.outputMoveTo(1,10,2000);
+  EXPECT_EQ(20, lucky7.o2);
 
   lucky7.o3 = 100;
-  lucky7.outputMoveTo(O3,lucky7.o3,100,999);
+  lucky7.outputMoveTo(2,100,999);
   EXPECT_EQ(100, lucky7.o3);
+  EXPECT_EQ(0x3, lucky7.rampActive);
 
-  lucky7.o1 = 0;
-  lucky7.o1MoveTo(10,999);
-  EXPECT_EQ(10, lucky7.o1);
+  lucky7.rampOutputs(1005);
+  EXPECT_EQ(15, lucky7.o1);
+  EXPECT_EQ(18, lucky7.o2);
+  EXPECT_EQ(100, lucky7.o3);
 
-  lucky7.o2 = 10;
-  lucky7.o2MoveTo(0,999);
-  EXPECT_EQ(0, lucky7.o2);
+  lucky7.rampOutputs(1010);
+  EXPECT_EQ(20, lucky7.o1);
+  EXPECT_EQ(15, lucky7.o2);
+  EXPECT_EQ(0x2, lucky7.rampActive);
 
-  lucky7.o3 = 0;
-  lucky7.o3MoveTo(10,999);
-  EXPECT_EQ(10, lucky7.o3);
+  // Well past the end of the ramp
+  lucky7.rampOutputs(100000);
+  EXPECT_EQ(10, lucky7.o2);
+  EXPECT_EQ(0, lucky7.rampActive);
 
+  // No ramp running, so the start of this one reads millis() again
+  arduinoMock->setMillisRaw(200000);
   lucky7.o4 = 0;
-  lucky7.o4MoveTo(1,999);
+  lucky7.outputMoveTo(3,1,999);
+  EXPECT_EQ(0, lucky7.o4);
+  lucky7.rampOutputs(200001);
   EXPECT_EQ(1, lucky7.o4);
 
+  // A step delay of 0 moves right away, on every output
   lucky7.o5 = 1;
-  lucky7.o5MoveTo(2,999);
+  lucky7.outputMoveTo(4,2,0);
   EXPECT_EQ(2, lucky7.o5);
 
   lucky7.o6 = 2;
-  lucky7.o6MoveTo(3,999);
+  lucky7.outputMoveTo(5,3,0);
   EXPECT_EQ(3, lucky7.o6);
 
   lucky7.o7 = 3;
-  lucky7.o7MoveTo(4,999);
+  lucky7.outputMoveTo(6,4,0);
   EXPECT_EQ(4, lucky7.o7);
 
   lucky7.o8 = 4;
-  lucky7.o8MoveTo(5,999);
+  lucky7.outputMoveTo(7,5,0);
   EXPECT_EQ(5, lucky7.o8);
 
   lucky7.o13 = 5;
-  lucky7.o13MoveTo(6,999);
+  lucky7.outputMoveTo(8,6,0);
   EXPECT_EQ(6, lucky7.o13);
+  EXPECT_EQ(0, lucky7.rampActive);
   
   releaseArduinoMock();
   
 }
+
+TEST(Lucky7Test, Crossfade) {
+  Lucky7 lucky7 = Lucky7();
+  lucky7.crossfadeOutputs = 0;
+  lucky7.setCrossfade(1, true);
+  lucky7.setCrossfade(2, true);
+
+  // Not crossfading
+  EXPECT_EQ(0x100, lucky7.crossfadeFraction(0));
+  EXPECT_EQ(200, lucky7.shownLevel(1, 200, 0x100));
+  EXPECT_EQ(50,  lucky7.shownLevel(2,  50, 0x100));
+
+  lucky7.crossfade(1000);
+  // Starts on the next loop()
+  EXPECT_EQ(0,   lucky7.crossfadeFraction(5000));
+  EXPECT_EQ(200, lucky7.shownLevel(1, 0,   0));
+  EXPECT_EQ(50,  lucky7.shownLevel(2, 150, 0));
+
+  EXPECT_EQ(128, lucky7.crossfadeFraction(5500));
+  EXPECT_EQ(100, lucky7.shownLevel(1, 0,   128));
+  EXPECT_EQ(100, lucky7.shownLevel(2, 150, 128));
+
+  EXPECT_EQ(0x100, lucky7.crossfadeFraction(6000));
+  EXPECT_EQ(0,   lucky7.crossfadeLength);
+  EXPECT_EQ(0,   lucky7.shownLevel(1, 0,   0x100));
+  EXPECT_EQ(150, lucky7.shownLevel(2, 150, 0x100));
+
+  // A new crossfade starts from what is showing, not from the last target
+  lucky7.crossfade(1000);
+  EXPECT_EQ(0,   lucky7.crossfadeFrom[0]);
+  EXPECT_EQ(150, lucky7.crossfadeFrom[1]);
+
+  // An output left out, say a motor, goes straight to its level
+  lucky7.setCrossfade(2, false);
+  EXPECT_EQ(0x01, lucky7.crossfadeOutputs);
+  EXPECT_EQ(0,   lucky7.crossfadeFraction(7000));
+  EXPECT_EQ(0,   lucky7.shownLevel(2, 0, 0));
+  EXPECT_EQ(0,   lucky7.shownLevel(1, 200, 0));
+}
+
+TEST(Lucky7Test, OutputCurveDither) {
+  uint16_t level;
+  for (level = 0; level <= ON; level++) {
+    EXPECT_EQ(level << 4, Lucky7::outputCurveValue(Lucky7::CURVE_LINEAR, level));
+    if (level > 0) {
+      EXPECT_GE(Lucky7::outputCurveValue(Lucky7::CURVE_LED, level),
+                Lucky7::outputCurveValue(Lucky7::CURVE_LED, level - 1));
+      EXPECT_GE(Lucky7::outputCurveValue(Lucky7::CURVE_BULB, level),
+                Lucky7::outputCurveValue(Lucky7::CURVE_BULB, level - 1));
+      // LEDs need more of the range for the dim end than bulbs
+      EXPECT_LE(Lucky7::outputCurveValue(Lucky7::CURVE_LED, level),
+                Lucky7::outputCurveValue(Lucky7::CURVE_BULB, level));
+    }
+  }
+  EXPECT_EQ(0,    Lucky7::outputCurveValue(Lucky7::CURVE_LED,  OFF));
+  EXPECT_EQ(0,    Lucky7::outputCurveValue(Lucky7::CURVE_BULB, OFF));
+  EXPECT_EQ(4080, Lucky7::outputCurveValue(Lucky7::CURVE_LED,  ON));
+  EXPECT_EQ(4080, Lucky7::outputCurveValue(Lucky7::CURVE_BULB, ON));
+  // Half the light level is about 22% of the power: 4080*(128/255)^2.2
+  EXPECT_NEAR(896, Lucky7::outputCurveValue(Lucky7::CURVE_LED, 128), 1);
+
+  Lucky7 lucky7 = Lucky7();
+  lucky7.setOutputCurve(1, Lucky7::CURVE_LED);
+  lucky7.setOutputCurve(2, Lucky7::CURVE_BULB);
+
+  // Other outputs are not changed
+  EXPECT_EQ(77, lucky7.outputLevel(3, 77));
+
+  // Over 16 loops the dithered PWM levels add up to the 12 bit level
+  for (level = 0; level <= ON; level++) {
+    const uint16_t led  = Lucky7::outputCurveValue(Lucky7::CURVE_LED,  level);
+    const uint16_t bulb = Lucky7::outputCurveValue(Lucky7::CURVE_BULB, level);
+    lucky7.setOutputCurve(1, Lucky7::CURVE_LED);
+    lucky7.setOutputCurve(2, Lucky7::CURVE_BULB);
+    uint16_t ledSum = 0, bulbSum = 0;
+    for (uint8_t i = 0; i < 16; i++) {
+      const uint8_t ledPWM  = lucky7.outputLevel(1, level);
+      const uint8_t bulbPWM = lucky7.outputLevel(2, level);
+      EXPECT_LE(ledPWM  - (led  >> 4), 1);
+      EXPECT_LE(bulbPWM - (bulb >> 4), 1);
+      ledSum  += ledPWM;
+      bulbSum += bulbPWM;
+    }
+    EXPECT_EQ(led,  ledSum)  << "level = " << level;
+    EXPECT_EQ(bulb, bulbSum) << "level = " << level;
+  }
+}
+
+TEST(SensorFilter, RunningAverage) {
+  RunningAverageFilter<AVECNT> filter;
+  filter.reset(100);
+  EXPECT_EQ(100, filter.value());
+
+  uint16_t samples[AVECNT];
+  for (uint8_t i = 0; i < AVECNT; i++) {
+    samples[i] = 100;
+  }
+  for (uint16_t j = 0; j < 100; j++) {
+    const uint16_t sample = (j*37) % 1024;
+    samples[j % AVECNT] = sample;
+    filter.add(sample);
+
+    uint32_t sum = 0;
+    for (uint8_t i = 0; i < AVECNT; i++) {
+      sum += samples[i];
+    }
+    EXPECT_EQ(sum/AVECNT, filter.value()) << "j = " << j;
+  }
+}
+
+TEST(SensorFilter, EMA) {
+  EMAFilter<3> filter;
+  filter.reset(0);
+  EXPECT_EQ(0, filter.value());
+
+  // Each sample moves the average 1/8 of the way there
+  filter.add(800);
+  EXPECT_EQ(100, filter.value());
+  for (uint8_t j = 0; j < 100; j++) {
+    filter.add(800);
+  }
+  EXPECT_EQ(800, filter.value());
+
+  filter.reset(1023);
+  EXPECT_EQ(1023, filter.value());
+}
+
+TEST(SensorFilter, Median) {
+  // The networks sort every order of distinct values
+  uint16_t order[5] = {1, 2, 3, 4, 5};
+  do {
+    uint16_t v[5] = {order[0], order[1], order[2], order[3], order[4]};
+    lucky7SortingNetwork<5>(v);
+    for (uint8_t i = 0; i < 5; i++) {
+      EXPECT_EQ(i+1, v[i]);
+    }
+  } while (std::next_permutation(order, order + 5));
+  uint16_t order3[3] = {1, 2, 3};
+  do {
+    uint16_t v[3] = {order3[0], order3[1], order3[2]};
+    lucky7SortingNetwork<3>(v);
+    for (uint8_t i = 0; i < 3; i++) {
+      EXPECT_EQ(i+1, v[i]);
+    }
+  } while (std::next_permutation(order3, order3 + 3));
+
+  // A spike of up to 2 samples in 5 does not get through
+  MedianFilter<5> filter;
+  filter.reset(500);
+  filter.add(1000);
+  EXPECT_EQ(500, filter.value());
+  filter.add(1000);
+  EXPECT_EQ(500, filter.value());
+  filter.add(1000);
+  EXPECT_EQ(1000, filter.value());
+}
+
+TEST(SensorFilter, Oversampling) {
+  OversamplingFilter<2, RunningAverageFilter<4> > filter;
+  EXPECT_EQ(2, int(filter.extraBits));
+  filter.reset(100);
+  EXPECT_EQ(400, filter.value());
+
+  // Samples dithering between 100 and 101 average to 100.5, which two
+  // extra bits can show
+  for (uint8_t j = 0; j < 4*16; j++) {
+    filter.add(100 + (j & 1));
+  }
+  EXPECT_EQ(402, filter.value());
+}
@@ -5,12 +5,12 @@ TEST(TimeOfDayTest, setup) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(1);
+    .Times(0);
 
   arduinoMock->setMillisRaw(0);
 
   TimeOfDay tod = TimeOfDay();
-  tod.setup(0,1000,10);
+  tod.setup(0,1000,10,0);
 
   // Test TimeOfDay.setup()
   EXPECT_EQ(10, tod.nightDayThresholdPercentage);
@@ -22,9 +22,18 @@ TEST(TimeOfDayTest, setup) {
   EXPECT_EQ(LUCKY7_TIME5MIN, tod.update5minTimeout);
   EXPECT_EQ(LUCKY7_TIME4HOUR, tod.eveningLength);
   EXPECT_EQ(LUCKY7_TIME2HOUR, tod.morningLength);
-  EXPECT_EQ(0, tod.photocellValuesIndex);
+  EXPECT_EQ(0, tod.photocellValuesCount);
+  EXPECT_EQ(0, tod.photocellValuesSum);
+  for (uint8_t i = 0; i < PHOTOCELLDAYS; i++) {
+    EXPECT_EQ(0,    tod.photocellDays[i].min);
+    EXPECT_EQ(1000, tod.photocellDays[i].max);
+  }
+  EXPECT_EQ(0, tod.photocellDaysIndex);
+  EXPECT_EQ(0, tod.photocellDayUpdates);
 
   EXPECT_EQ(LUCKY7_TIME12HOUR, tod.lengthOfNight);
+  EXPECT_EQ(LUCKY7_TIME12HOUR, tod.getNightForecast());
+  EXPECT_EQ(0, tod.nightsCount);
   EXPECT_EQ(0, tod.nightStart);
   EXPECT_EQ(0, tod.dayStart);
   EXPECT_EQ(TimeOfDay::DAY, tod.getDayPart());
@@ -36,12 +45,12 @@ TEST(TimeOfDayTest, getNightDayThreshold) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(1);
+    .Times(0);
 
   arduinoMock->setMillisRaw(0);
 
   TimeOfDay tod = TimeOfDay();
-  tod.setup(0,1000,10);
+  tod.setup(0,1000,10,0);
 
   tod.photocellAvgValueMin = 0;
   tod.photocellAvgValueMax = 1000;
@@ -65,12 +74,12 @@ TEST(TimeOfDayTest, UpdatePhotocellAvgValues) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(1);
+    .Times(0);
 
   arduinoMock->setMillisRaw(0);
 
   TimeOfDay tod = TimeOfDay();
-  tod.setup(500,501,10);
+  tod.setup(500,501,10,0);
 
   uint16_t values   [10] = {801, 900, 950,1000, 410, 323, 281, 102,  13, 824};
   uint16_t valuesMin[10] = {500, 500, 500, 500, 410, 323, 281, 102,  13,  13};
@@ -87,6 +96,43 @@ TEST(TimeOfDayTest, UpdatePhotocellAvgValues) {
   releaseArduinoMock();
 }
 
+TEST(TimeOfDayTest, PhotocellDays) {
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+
+  EXPECT_CALL(*arduinoMock, millis())
+    .Times(0);
+
+  arduinoMock->setMillisRaw(0);
+
+  TimeOfDay tod = TimeOfDay();
+  tod.setup(500,501,10,0);
+
+  // A flash on the first day, then every day the same
+  tod.updatePhotocellAvgValues(1000);
+  EXPECT_EQ(1000, tod.getPhotocellAvgValueMax());
+  for (uint8_t day = 0; day < PHOTOCELLDAYS; day++) {
+    for (uint16_t i = (day == 0) ? 1 : 0; i < PHOTOCELLDAYUPDATES; i++) {
+      tod.updatePhotocellAvgValues(600);
+    }
+    EXPECT_EQ((day + 1) % PHOTOCELLDAYS, tod.photocellDaysIndex);
+    EXPECT_EQ(0, tod.photocellDayUpdates);
+    if (day + 1 < PHOTOCELLDAYS) {
+      // The first day, with the flash and the setup() min, is still there
+      EXPECT_EQ(500,  tod.getPhotocellAvgValueMin()) << "day = " << int(day);
+      EXPECT_EQ(1000, tod.getPhotocellAvgValueMax()) << "day = " << int(day);
+    }
+  }
+  EXPECT_EQ(600, tod.getPhotocellAvgValueMin());
+  EXPECT_EQ(600, tod.getPhotocellAvgValueMax());
+
+  // A darker day widens min straight away, and keeps it for PHOTOCELLDAYS
+  tod.updatePhotocellAvgValues(100);
+  EXPECT_EQ(100, tod.getPhotocellAvgValueMin());
+  EXPECT_EQ(150, tod.getNightDayThreshold());
+
+  releaseArduinoMock();
+}
+
 TEST(TimeOfDayTest, UpdateAverage) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
@@ -96,7 +142,7 @@ TEST(TimeOfDayTest, UpdateAverage) {
   arduinoMock->setMillisRaw(0);
 
   TimeOfDay tod = TimeOfDay();
-  tod.setup(100,250,10);
+  tod.setup(100,250,10,0);
 
   uint16_t * lightLevel;
   uint16_t   lightLevelArray[4][10] =
@@ -129,6 +175,80 @@ TEST(TimeOfDayTest, UpdateAverage) {
   releaseArduinoMock();
 }
 
+TEST(TimeOfDayTest, LearnNight) {
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+
+  EXPECT_CALL(*arduinoMock, millis())
+    .Times(0);
+
+  arduinoMock->setMillisRaw(0);
+
+  TimeOfDay tod = TimeOfDay();
+  tod.setup(100,900,10,0);
+
+  const uint32_t min = LUCKY7_TIME1MIN;
+
+  // Not nights
+  tod.learnNight(LUCKY7_NIGHTMIN - 1);
+  tod.learnNight(LUCKY7_NIGHTMAX + 1);
+  EXPECT_EQ(0,                 tod.nightsCount);
+  EXPECT_EQ(LUCKY7_TIME12HOUR, tod.getNightForecast());
+  EXPECT_EQ(LUCKY7_TIME4HOUR,  tod.eveningLength);
+  EXPECT_EQ(LUCKY7_TIME2HOUR,  tod.predawnLength);
+
+  tod.learnNight(600*min);
+  EXPECT_EQ(600*min,     tod.getNightForecast());
+  EXPECT_EQ(198*min,     tod.eveningLength);
+  EXPECT_EQ(102*min,     tod.predawnLength);
+
+  // Nights getting 4 minutes longer, and more of them than are kept
+  const uint16_t nights[6]   = {604, 608, 612, 616, 620, 624};
+  const uint16_t forecast[6] = {608, 612, 616, 620, 624, 628};
+  for (uint8_t i = 0; i < 6; i++) {
+    tod.learnNight(nights[i]*min + 59999); // Part minutes are dropped
+    EXPECT_EQ(forecast[i]*min, tod.getNightForecast()) << "i = " << int(i);
+  }
+  EXPECT_EQ(NIGHTSSIZE, tod.nightsCount);
+
+  // One cloudy dawn, lights came on early, is not followed all the way
+  tod.learnNight(580*min);
+  EXPECT_EQ(598*min, tod.getNightForecast());
+
+  releaseArduinoMock();
+}
+
+TEST(TimeOfDayTest, UpdateAverageFewValues) {
+  ArduinoMock * arduinoMock = arduinoMockInstance();
+
+  EXPECT_CALL(*arduinoMock, millis())
+    .Times(0);
+
+  arduinoMock->setMillisRaw(0);
+
+  TimeOfDay tod = TimeOfDay();
+  tod.setup(100,900,10,0);
+
+  // Two readings in the five minutes, nothing to throw out
+  tod.updateAverage(400, LUCKY7_TIME30SEC);
+  EXPECT_EQ(1, tod.photocellValuesCount);
+  tod.updateAverage(200, LUCKY7_TIME5MIN);
+  EXPECT_EQ(300, tod.getPhotocellAvgValueCurrent());
+  EXPECT_EQ(0,   tod.photocellValuesCount);
+
+  // One
+  tod.updateAverage(700, 2*LUCKY7_TIME5MIN);
+  EXPECT_EQ(700, tod.getPhotocellAvgValueCurrent());
+
+  // Three, high and low thrown out
+  tod.updateAverage(100, 2*LUCKY7_TIME5MIN + LUCKY7_TIME30SEC);
+  tod.updateAverage(500, 2*LUCKY7_TIME5MIN + 2*LUCKY7_TIME30SEC);
+  tod.updateAverage(600, 3*LUCKY7_TIME5MIN);
+  EXPECT_EQ(500, tod.getPhotocellAvgValueCurrent());
+  EXPECT_EQ(TimeOfDay::DAY, tod.getDayPart());
+
+  releaseArduinoMock();
+}
+
 TEST(TimeOfDayTest, UpdateTimeOfDay) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
@@ -157,6 +277,8 @@ TEST(TimeOfDayTest, UpdateTimeOfDay) {
   // tod.predawnLength = LUCKY7_TIME2HOUR;
   // tod.morningLength = LUCKY7_TIME2HOUR;
   // tod.lengthOfNight = LUCKY7_TIME12HOUR;
+  // After the first night of 482 minutes, the forecast is 482 minutes,
+  // evening is 33% of it, 159 minutes, and predawn 17%, 82 minutes.
 
   // D=68, E=69, M=77, N=78, P=80
 
@@ -212,16 +334,16 @@ TEST(TimeOfDayTest, UpdateTimeOfDay) {
      day, day, day, day, day, day,
      // Day 2
      day,
-     evening, evening, evening, evening, evening,
-     night, night, night,
-     predawn, predawn, predawn,
+     evening, evening, evening, night,   night,
+     night,   night,   night,
+     night,   predawn, predawn,
      morning, morning, morning,
      day, day, day, day, day, day,
      // Day 3
      day,
-     evening, evening, evening, evening, evening,
-     night, night, night,
-     predawn, predawn, predawn,
+     evening, evening, evening, night,   night,
+     night,   night,   night,
+     night,   predawn, predawn,
      morning, morning, morning,
      day, day, day, day, day, day,
     };
@@ -292,7 +414,7 @@ TEST(TimeOfDayTest, UpdateTimeOfDay) {
   arduinoMock->setMillisRaw(0);
 
   TimeOfDay tod = TimeOfDay();
-  tod.setup(100,900,10);
+  tod.setup(100,900,10,0);
 
   EXPECT_EQ(TimeOfDay::DAY, tod.getDayPart());
 
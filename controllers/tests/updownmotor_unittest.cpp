@@ -104,7 +104,7 @@ TEST_F(UpDownMotorTest, MotorUpStart) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(1);
+    .Times(0);
 
   uint32_t millisSet = 9283*60*60;
   arduinoMock->setMillisRaw(millisSet);
@@ -123,7 +123,7 @@ TEST_F(UpDownMotorTest, MotorUpStart) {
   for (uint8_t i = 0; i < 2; i++) {
     udm.inMotorUpMode = inMotorUpModeArray[i];
 
-    udm.motorUpStart();
+    udm.motorUpStart(millisSet);
     EXPECT_EQ(millisSet, udm.motorUpStartTime);
     EXPECT_TRUE(udm.inMotorUpMode);
   }
@@ -135,7 +135,7 @@ TEST_F(UpDownMotorTest, MotorDownStart) {
   ArduinoMock * arduinoMock = arduinoMockInstance();
 
   EXPECT_CALL(*arduinoMock, millis())
-    .Times(1);
+    .Times(0);
 
   uint32_t millisSet = 9283*60*60;
   arduinoMock->setMillisRaw(millisSet);
@@ -154,7 +154,7 @@ TEST_F(UpDownMotorTest, MotorDownStart) {
   for (uint8_t i = 0; i < 2; i++) {
     udm.inMotorDownMode = inMotorDownModeArray[i];
 
-    udm.motorDownStart();
+    udm.motorDownStart(millisSet);
     EXPECT_EQ(millisSet, udm.motorDownStartTime);
     EXPECT_TRUE(udm.inMotorDownMode);
   }